@@ -1,17 +1,76 @@
-#include <algorithm> // `std::sort`
-#include <cassert>   // `assert`
-#include <cmath>     // `std::pow`
-#include <cstdint>   // `std::int32_t`
-#include <cstring>   // `std::memcpy`, `std::strcmp`
-#include <execution> // `std::execution::par_unseq`
-#include <fstream>   // `std::ifstream`
-#include <iterator>  // `std::random_access_iterator_tag`
-#include <new>       // `std::launder`
-#include <random>    // `std::mt19937`
-#include <vector>    // `std::algorithm`
+#include <algorithm>          // `std::sort`
+#include <array>              // `std::array`
+#include <atomic>             // `std::atomic`
+#include <cassert>            // `assert`
+#include <chrono>             // `std::chrono::steady_clock`
+#include <climits>            // `CHAR_BIT`
+#include <cmath>              // `std::pow`
+#include <condition_variable> // `std::condition_variable`
+#include <cstdint>            // `std::int32_t`
+#include <cstdlib>            // `std::getenv`
+#include <cstring>            // `std::memcpy`, `std::strcmp`
+#include <execution>          // `std::execution::par_unseq`
+#include <fstream>            // `std::ifstream`
+#include <functional>         // `std::less`
+#include <iterator>           // `std::random_access_iterator_tag`
+#include <limits>             // `std::numeric_limits`
+#include <map>                // `std::map`
+#include <memory>             // `std::unique_ptr`
+#include <memory_resource>    // `std::pmr::memory_resource`
+#include <mutex>              // `std::mutex`
+#include <new>                // `std::launder`
+#include <numeric>            // `std::iota`
+#include <random>             // `std::mt19937`
+#include <shared_mutex>       // `std::shared_mutex`
+#include <string>             // `std::string`
+#include <string_view>        // `std::string_view`
+#include <thread>             // `std::thread::hardware_concurrency`
+#include <type_traits>        // `std::is_signed`
+#include <typeinfo>           // `typeid`
+#include <utility>            // `std::index_sequence`
+#include <vector>             // `std::algorithm`
+
+#if __has_include(<barrier>)
+#include <barrier> // `std::barrier`, only in C++20
+#endif
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine> // `std::coroutine_handle`, only in C++20
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h> // `_mm512_permutexvar_epi32`
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>       // `posix_fallocate`, `F_PREALLOCATE`
+#include <stdlib.h>      // `mkstemp`
+#include <sys/mman.h>    // `mmap`, `madvise`
+#include <sys/statvfs.h> // `statvfs`
+#include <unistd.h>      // `ftruncate`, `unlink`, `sysconf`
+#endif
+
+#if defined(__linux__)
+#include <linux/futex.h>      // `FUTEX_WAIT_PRIVATE`, `FUTEX_WAKE_PRIVATE`
+#include <linux/perf_event.h> // `perf_event_attr`, `PERF_COUNT_HW_CACHE_MISSES`
+#include <pthread.h>          // `pthread_setaffinity_np`
+#include <sched.h>            // `sched_getaffinity`, `CPU_SET`
+#include <sys/ioctl.h>        // `ioctl`
+#include <sys/syscall.h>      // `SYS_perf_event_open`, `SYS_futex`
+#endif
 
 #include <benchmark/benchmark.h>
 
+#if defined(TUTORIAL_USE_TBB)
+#include <tbb/blocked_range.h>           // `tbb::blocked_range`
+#include <tbb/global_control.h>          // `tbb::global_control::max_allowed_parallelism`
+#include <tbb/parallel_for.h>            // `tbb::parallel_for`
+#include <tbb/parallel_reduce.h>         // `tbb::parallel_reduce`
+#include <tbb/parallel_invoke.h>         // `tbb::parallel_invoke`
+#include <tbb/task_arena.h>              // `tbb::this_task_arena::max_concurrency`
+#include <tbb/task_scheduler_observer.h> // `tbb::task_scheduler_observer`
+#endif
+
 namespace bm = benchmark;
 
 static void i32_addition(bm::State &state) {
@@ -54,7 +113,8 @@ BENCHMARK(i32_addition_semi_random);
 
 // Our `rand()` is 100 cycles on a single core, but it involves
 // global state management, so it can be as slow 12'000 ns with
-// just 8 threads.
+// just 8 threads. The "Atomics Under Contention" section measures
+// the cost of such shared state in isolation.
 BENCHMARK(i32_addition_random)->Threads(8);
 BENCHMARK(i32_addition_semi_random)->Threads(8);
 
@@ -199,8 +259,11 @@ BENCHMARK(u64_population_count_x86);
 // ------------------------------------
 
 struct memory_specs_t {
-    std::size_t l2_cache_size = 1024 * 1024; ///< Default to 1MB
-    std::size_t cache_line_size = 64;        ///< Default to 64 bytes
+    std::size_t l1_cache_size = 32 * 1024;       ///< Default to 32KB of data cache
+    std::size_t l2_cache_size = 1024 * 1024;     ///< Default to 1MB
+    std::size_t l3_cache_size = 8 * 1024 * 1024; ///< Default to 8MB, zero if there is none
+    std::size_t cache_line_size = 64;            ///< Default to 64 bytes
+    std::size_t ram_size = 0;                    ///< Physical memory, zero if unknown
 };
 
 std::size_t parse_size_string(std::string const &str) {
@@ -229,7 +292,11 @@ memory_specs_t fetch_memory_specs() {
 
 #if defined(__linux__)
     specs.cache_line_size = read_file_contents("/sys/devices/system/cpu/cpu0/cache/index0/coherency_line_size");
+    specs.l1_cache_size = read_file_contents("/sys/devices/system/cpu/cpu0/cache/index0/size");
     specs.l2_cache_size = read_file_contents("/sys/devices/system/cpu/cpu0/cache/index2/size");
+    specs.l3_cache_size = read_file_contents("/sys/devices/system/cpu/cpu0/cache/index3/size");
+    specs.ram_size =
+        static_cast<std::size_t>(::sysconf(_SC_PHYS_PAGES)) * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
 
 #elif defined(__APPLE__)
     size_t size;
@@ -237,9 +304,18 @@ memory_specs_t fetch_memory_specs() {
     if (sysctlbyname("hw.cachelinesize", &size, &len, nullptr, 0) == 0) {
         specs.cache_line_size = size;
     }
+    if (sysctlbyname("hw.l1dcachesize", &size, &len, nullptr, 0) == 0) {
+        specs.l1_cache_size = size;
+    }
     if (sysctlbyname("hw.l2cachesize", &size, &len, nullptr, 0) == 0) {
         specs.l2_cache_size = size;
     }
+    specs.l3_cache_size = sysctlbyname("hw.l3cachesize", &size, &len, nullptr, 0) == 0 ? size : 0;
+    std::uint64_t ram_size = 0;
+    len = sizeof(ram_size);
+    if (sysctlbyname("hw.memsize", &ram_size, &len, nullptr, 0) == 0) {
+        specs.ram_size = static_cast<std::size_t>(ram_size);
+    }
 
 #elif defined(_WIN32)
     SYSTEM_LOGICAL_PROCESSOR_INFORMATION buffer[256];
@@ -252,13 +328,35 @@ memory_specs_t fetch_memory_specs() {
             if (buffer[i].Relationship == RelationCache && buffer[i].Cache.Level == 1) {
                 specs.cache_line_size = buffer[i].Cache.LineSize;
             }
+            if (buffer[i].Relationship == RelationCache && buffer[i].Cache.Level == 1 &&
+                buffer[i].Cache.Type == CacheData) {
+                specs.l1_cache_size = buffer[i].Cache.Size;
+            }
+            if (buffer[i].Relationship == RelationCache && buffer[i].Cache.Level == 3) {
+                specs.l3_cache_size = buffer[i].Cache.Size;
+            }
         }
     }
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status)) {
+        specs.ram_size = static_cast<std::size_t>(status.ullTotalPhys);
+    }
 #endif
 
     return specs;
 }
 
+/// @brief  Checks if a benchmark can allocate and touch `bytes` without waking up the OOM killer.
+///
+/// With Linux overcommit, even a `new` far beyond the physical memory succeeds, and the process is only
+/// killed when it touches the pages. So the size is checked against the physical memory first,
+/// leaving half of it to the OS, the other processes, and the rest of the benchmarks.
+inline bool fits_in_memory(std::size_t bytes) {
+    static std::size_t const ram_size = fetch_memory_specs().ram_size;
+    return !ram_size || bytes <= ram_size / 2;
+}
+
 /// Calling `std::rand` is clearly expensive, but in some cases we need a semi-random behaviour.
 /// A relatively cheap and widely available alternative is to use CRC32 hashes to define the transformation,
 /// without pre-computing some random ordering.
@@ -468,6 +566,359 @@ static void cost_of_pausing(bm::State &state) {
 
 BENCHMARK(cost_of_pausing);
 
+// ------------------------------------
+// ## Roofline Model
+// ------------------------------------
+//
+// Neither FLOP/s nor GB/s alone tell how much faster a kernel could get. The roofline model bounds it by
+// `min(peak_flops, arithmetic_intensity * bandwidth)`, where the arithmetic intensity is the number of operations
+// per byte moved, and the bandwidth is the one of the memory level that the working set fits in.
+// Kernels left of the "ridge point", where both ceilings meet, are memory-bound, and the rest are compute-bound.
+// https://en.wikipedia.org/wiki/Roofline_model
+//
+// Vendor specs are rarely reachable on a given machine, so we calibrate the ceilings once at startup:
+// the throughput of fused multiply-adds for every ISA level and precision, and the read bandwidth of every
+// level of the memory hierarchy. Benchmarks declare the work of a single iteration, and report how close
+// to the roof they got.
+
+/// Google Benchmark can only compare different runs offline, with `compare.py`.
+/// When a counter must be relative to another configuration, we time that configuration
+/// once per input size and cache the result for the remaining runs.
+/// Short workloads may need a few `repetitions`, keeping the fastest, to exclude the warm-up of caches and clocks.
+template <typename callable_at>
+double reference_seconds(std::string const &name, std::size_t count, callable_at &&callable,
+                         std::size_t repetitions = 1) {
+    static std::map<std::pair<std::string, std::size_t>, double> cache;
+    auto key = std::make_pair(name, count);
+    auto it = cache.find(key);
+    if (it != cache.end())
+        return it->second;
+    double seconds = std::numeric_limits<double>::max();
+    for (std::size_t repetition = 0; repetition != repetitions; ++repetition) {
+        auto start = std::chrono::steady_clock::now();
+        callable();
+        seconds = std::min(seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    cache.emplace(key, seconds);
+    return seconds;
+}
+
+/// @brief  Like `reference_seconds`, for workloads that consume their input, like sorts. The `prepare` step
+///         restores the input before every run, outside of the timed region. A warm-up run is discarded, and
+///         the median of the remaining `repetitions` is kept, as a single cold run of a large sort is too noisy.
+template <typename prepare_at, typename callable_at>
+double prepared_reference_seconds(std::string const &name, std::size_t count, prepare_at &&prepare,
+                                  callable_at &&callable, std::size_t repetitions = 3) {
+    static std::map<std::pair<std::string, std::size_t>, double> cache;
+    auto key = std::make_pair(name, count);
+    auto it = cache.find(key);
+    if (it != cache.end())
+        return it->second;
+    std::vector<double> samples;
+    for (std::size_t repetition = 0; repetition <= repetitions; ++repetition) {
+        prepare();
+        auto start = std::chrono::steady_clock::now();
+        callable();
+        double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (repetition != 0)
+            samples.push_back(seconds);
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    double const seconds = samples[samples.size() / 2];
+    cache.emplace(key, seconds);
+    return seconds;
+}
+
+enum roofline_isa_t {
+    roofline_scalar_k,
+    roofline_sse_k,
+    roofline_avx2_k,
+    roofline_avx512_k,
+    roofline_isas_count_k,
+};
+
+enum roofline_level_t {
+    roofline_l1_k,
+    roofline_l2_k,
+    roofline_l3_k,
+    roofline_ram_k,
+    roofline_levels_count_k,
+};
+
+#if defined(__AVX512F__)
+constexpr roofline_isa_t roofline_widest_k = roofline_avx512_k;
+#elif defined(__AVX2__) && defined(__FMA__)
+constexpr roofline_isa_t roofline_widest_k = roofline_avx2_k;
+#elif defined(__SSE2__)
+constexpr roofline_isa_t roofline_widest_k = roofline_sse_k;
+#else
+constexpr roofline_isa_t roofline_widest_k = roofline_scalar_k;
+#endif
+
+inline char const *roofline_isa_name(roofline_isa_t isa) noexcept {
+    switch (isa) {
+    case roofline_scalar_k:
+        return "scalar";
+    case roofline_sse_k:
+        return "sse";
+    case roofline_avx2_k:
+        return "avx2";
+    case roofline_avx512_k:
+        return "avx512";
+    default:
+        return "unknown";
+    }
+}
+
+inline char const *roofline_level_name(roofline_level_t level) noexcept {
+    switch (level) {
+    case roofline_l1_k:
+        return "l1";
+    case roofline_l2_k:
+        return "l2";
+    case roofline_l3_k:
+        return "l3";
+    case roofline_ram_k:
+        return "ram";
+    default:
+        return "unknown";
+    }
+}
+
+/// Sums 64-bit words in several independent registers, so that the loop is bound by loads
+/// and not by the latency of additions, as a single vectorized `std::accumulate` would be in L1.
+inline std::uint64_t roofline_sum_words(std::uint64_t const *words, std::size_t count) noexcept {
+    std::size_t i = 0;
+    std::uint64_t sum = 0;
+#if defined(__AVX512F__)
+    __m512i sums[4];
+    for (__m512i &partial : sums)
+        partial = _mm512_setzero_si512();
+    for (; i + 32 <= count; i += 32)
+        for (std::size_t j = 0; j != 4; ++j)
+            sums[j] = _mm512_add_epi64(sums[j], _mm512_loadu_si512(words + i + j * 8));
+    std::uint64_t lanes[8];
+    _mm512_storeu_si512(lanes, _mm512_add_epi64(_mm512_add_epi64(sums[0], sums[1]), //
+                                                _mm512_add_epi64(sums[2], sums[3])));
+    sum = std::accumulate(lanes, lanes + 8, std::uint64_t(0));
+#elif defined(__AVX2__)
+    __m256i sums[4];
+    for (__m256i &partial : sums)
+        partial = _mm256_setzero_si256();
+    for (; i + 16 <= count; i += 16)
+        for (std::size_t j = 0; j != 4; ++j)
+            sums[j] = _mm256_add_epi64(sums[j], _mm256_loadu_si256(reinterpret_cast<__m256i const *>(words + i) + j));
+    std::uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes),
+                        _mm256_add_epi64(_mm256_add_epi64(sums[0], sums[1]), _mm256_add_epi64(sums[2], sums[3])));
+    sum = std::accumulate(lanes, lanes + 4, std::uint64_t(0));
+#endif
+    for (; i != count; ++i)
+        sum += words[i];
+    return sum;
+}
+
+/// Single-core read bandwidth of a buffer of the given size, streamed over and over until 256 MB are read.
+inline double roofline_read_bandwidth(std::size_t bytes) {
+    std::vector<std::uint64_t> words(bytes / sizeof(std::uint64_t), 1);
+    std::size_t const passes = std::max<std::size_t>(1, (std::size_t(1) << 28) / bytes);
+    double const seconds = reference_seconds(
+        "roofline_read_bandwidth", bytes,
+        [&] {
+            for (std::size_t pass = 0; pass != passes; ++pass)
+                bm::DoNotOptimize(roofline_sum_words(words.data(), words.size()));
+        },
+        3);
+    return static_cast<double>(words.size() * sizeof(std::uint64_t) * passes) / seconds;
+}
+
+/// @brief  Measures the ceiling for multi-threaded kernels: every hardware thread streaming through its own slice
+///         of a 2 GB buffer, larger than any cache.
+inline double memory_read_bandwidth() {
+    std::size_t const count = std::size_t(1) << 28;
+    std::size_t const threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::uint64_t> words;
+    double const seconds = reference_seconds(
+        "memory_read_bandwidth", count,
+        [&] {
+            if (words.empty())
+                words.assign(count, 1);
+            std::vector<std::thread> workers;
+            for (std::size_t thread = 0; thread != threads; ++thread)
+                workers.emplace_back([&, thread] {
+                    std::size_t const begin = count * thread / threads, end = count * (thread + 1) / threads;
+                    bm::DoNotOptimize(roofline_sum_words(words.data() + begin, end - begin));
+                });
+            for (std::thread &worker : workers)
+                worker.join();
+        },
+        5);
+    return static_cast<double>(count * sizeof(std::uint64_t)) / seconds;
+}
+
+/// @brief  Single-core throughput of fused multiply-adds, counted as 2 operations per lane.
+///
+/// A single chain of FMAs is bound by their latency of 4-5 cycles. With 2 FMA ports, at least 10 independent
+/// accumulators are needed to keep both busy. We take 12, so that with the 2 constants they still fit into
+/// the 16 registers available before AVX-512.
+template <typename register_at, typename splat_at, typename fma_at>
+double roofline_peak_flops(std::string const &name, std::size_t lanes, splat_at &&splat, fma_at &&fma) {
+    constexpr std::size_t accumulators_k = 12, rounds_k = 1 << 22;
+    double const seconds = reference_seconds(
+        name, rounds_k,
+        [&] {
+            // Converging to 1, the accumulators never overflow or become subnormal.
+            register_at const multiplier = splat(0.999), addend = splat(0.001);
+            register_at accumulators[accumulators_k];
+            for (register_at &accumulator : accumulators)
+                accumulator = splat(1);
+            for (std::size_t round = 0; round != rounds_k; ++round)
+                for (register_at &accumulator : accumulators)
+                    accumulator = fma(accumulator, multiplier, addend);
+            bm::DoNotOptimize(accumulators);
+        },
+        3);
+    return 2.0 * lanes * accumulators_k * rounds_k / seconds;
+}
+
+struct roofline_ceilings_t {
+    /// Single-core operations per second for every ISA, with `float` and `double` lanes, or zero if unavailable.
+    double flops[roofline_isas_count_k][2] = {};
+    /// Single-core read bandwidth in bytes per second for every memory level.
+    double bandwidth[roofline_levels_count_k] = {};
+    /// The largest working set in bytes that every level can serve.
+    std::size_t capacity[roofline_levels_count_k] = {};
+};
+
+inline roofline_ceilings_t calibrate_roofline() {
+    roofline_ceilings_t ceilings;
+
+    // Scalar operations use the same ports as vector ones, but we still want to see the compiler emit them.
+    // The `_ss` and `_sd` intrinsics only touch the lowest lane, and will never be merged into wider registers.
+#if defined(__FMA__)
+    auto splat_f32 = [](double x) { return _mm_set1_ps(static_cast<float>(x)); };
+    auto splat_f64 = [](double x) { return _mm_set1_pd(x); };
+    ceilings.flops[roofline_scalar_k][0] = roofline_peak_flops<__m128>(
+        "roofline/f32/scalar", 1, splat_f32, [](__m128 a, __m128 b, __m128 c) { return _mm_fmadd_ss(a, b, c); });
+    ceilings.flops[roofline_scalar_k][1] = roofline_peak_flops<__m128d>(
+        "roofline/f64/scalar", 1, splat_f64, [](__m128d a, __m128d b, __m128d c) { return _mm_fmadd_sd(a, b, c); });
+    ceilings.flops[roofline_sse_k][0] = roofline_peak_flops<__m128>(
+        "roofline/f32/sse", 4, splat_f32, [](__m128 a, __m128 b, __m128 c) { return _mm_fmadd_ps(a, b, c); });
+    ceilings.flops[roofline_sse_k][1] = roofline_peak_flops<__m128d>(
+        "roofline/f64/sse", 2, splat_f64, [](__m128d a, __m128d b, __m128d c) { return _mm_fmadd_pd(a, b, c); });
+#else
+    ceilings.flops[roofline_scalar_k][0] = roofline_peak_flops<float>(
+        "roofline/f32/scalar", 1, [](double x) { return static_cast<float>(x); },
+        [](float a, float b, float c) { return a * b + c; });
+    ceilings.flops[roofline_scalar_k][1] = roofline_peak_flops<double>(
+        "roofline/f64/scalar", 1, [](double x) { return x; }, [](double a, double b, double c) { return a * b + c; });
+#if defined(__SSE2__)
+    ceilings.flops[roofline_sse_k][0] = roofline_peak_flops<__m128>(
+        "roofline/f32/sse", 4, [](double x) { return _mm_set1_ps(static_cast<float>(x)); },
+        [](__m128 a, __m128 b, __m128 c) { return _mm_add_ps(_mm_mul_ps(a, b), c); });
+    ceilings.flops[roofline_sse_k][1] = roofline_peak_flops<__m128d>(
+        "roofline/f64/sse", 2, [](double x) { return _mm_set1_pd(x); },
+        [](__m128d a, __m128d b, __m128d c) { return _mm_add_pd(_mm_mul_pd(a, b), c); });
+#endif
+#endif
+#if defined(__AVX2__) && defined(__FMA__)
+    ceilings.flops[roofline_avx2_k][0] = roofline_peak_flops<__m256>(
+        "roofline/f32/avx2", 8, [](double x) { return _mm256_set1_ps(static_cast<float>(x)); },
+        [](__m256 a, __m256 b, __m256 c) { return _mm256_fmadd_ps(a, b, c); });
+    ceilings.flops[roofline_avx2_k][1] = roofline_peak_flops<__m256d>(
+        "roofline/f64/avx2", 4, [](double x) { return _mm256_set1_pd(x); },
+        [](__m256d a, __m256d b, __m256d c) { return _mm256_fmadd_pd(a, b, c); });
+#endif
+#if defined(__AVX512F__)
+    ceilings.flops[roofline_avx512_k][0] = roofline_peak_flops<__m512>(
+        "roofline/f32/avx512", 16, [](double x) { return _mm512_set1_ps(static_cast<float>(x)); },
+        [](__m512 a, __m512 b, __m512 c) { return _mm512_fmadd_ps(a, b, c); });
+    ceilings.flops[roofline_avx512_k][1] = roofline_peak_flops<__m512d>(
+        "roofline/f64/avx512", 8, [](double x) { return _mm512_set1_pd(x); },
+        [](__m512d a, __m512d b, __m512d c) { return _mm512_fmadd_pd(a, b, c); });
+#endif
+
+    // Every cache level is measured on half of its capacity, to leave room for the stack, the code and
+    // the hardware prefetchers. Memory is measured on a buffer several times larger than the last level.
+    // Machines without an L3 see the L2 bandwidth reported for both.
+    memory_specs_t const specs = fetch_memory_specs();
+    ceilings.capacity[roofline_l1_k] = specs.l1_cache_size;
+    ceilings.capacity[roofline_l2_k] = std::max(specs.l2_cache_size, specs.l1_cache_size);
+    ceilings.capacity[roofline_l3_k] = std::max(specs.l3_cache_size, ceilings.capacity[roofline_l2_k]);
+    ceilings.capacity[roofline_ram_k] = std::numeric_limits<std::size_t>::max();
+    for (int level = roofline_l1_k; level != roofline_ram_k; ++level)
+        ceilings.bandwidth[level] = roofline_read_bandwidth(ceilings.capacity[level] / 2);
+    std::size_t const ram_bytes = std::clamp<std::size_t>(4 * ceilings.capacity[roofline_l3_k], 1 << 28, 1 << 30);
+    ceilings.bandwidth[roofline_ram_k] = roofline_read_bandwidth(ram_bytes);
+    return ceilings;
+}
+
+/// @brief  Logs the calibrated ceilings to `stderr`, as the reports may be streaming JSON into `stdout`.
+inline void log_roofline(roofline_ceilings_t const &ceilings) {
+    for (int isa = roofline_scalar_k; isa != roofline_isas_count_k; ++isa)
+        for (int precision = 0; precision != 2; ++precision)
+            if (ceilings.flops[isa][precision])
+                std::fprintf(stderr, "Roofline %s %s: %.1f GFLOP/s\n", precision ? "f64" : "f32",
+                             roofline_isa_name(static_cast<roofline_isa_t>(isa)),
+                             ceilings.flops[isa][precision] * 1e-9);
+    for (int level = roofline_l1_k; level != roofline_levels_count_k; ++level)
+        std::fprintf(stderr, "Roofline %s: %.1f GB/s\n", roofline_level_name(static_cast<roofline_level_t>(level)),
+                     ceilings.bandwidth[level] * 1e-9);
+}
+
+/// @brief  Calibrates the roofline on first use, so that runs filtering out every roofline benchmark,
+///         or just listing them, don't pay for the measurements and the gigabyte of memory they touch.
+inline roofline_ceilings_t const &roofline_ceilings() {
+    static roofline_ceilings_t const ceilings = [] {
+        roofline_ceilings_t result = calibrate_roofline();
+        log_roofline(result);
+        return result;
+    }();
+    return ceilings;
+}
+
+/// @brief  The work of a single benchmark iteration, as seen by the roofline model.
+///
+/// Integer operations are compared against the floating-point peak of the same width. On most cores,
+/// vector additions, comparisons and blends have at least the throughput of fused multiply-adds.
+struct roofline_work_t {
+    double operations = 0;                   ///< Arithmetic operations, counting a fused multiply-add as two
+    double bytes = 0;                        ///< Bytes read from and written to memory
+    std::size_t working_set = 0;             ///< Bytes touched, defining the memory level that serves them
+    std::size_t scalar_size = sizeof(float); ///< Picks the `float` or `double` peak
+    roofline_isa_t isa = roofline_scalar_k;
+    std::size_t threads = 1;
+};
+
+/// @brief  Reports the `arithmetic_intensity` of a kernel, and the `roofline_utilization` of the attainable
+///         throughput, measured over `seconds` of wall time for all of the `state.iterations()`.
+///
+/// L1 and L2 caches are private, so their bandwidth scales with the number of threads. The L3 cache is shared,
+/// so it is bound by the single measured figure, and the memory bandwidth is capped by the multi-threaded
+/// measurement. Wider registers don't always mean more throughput: some cores have fewer 512-bit FMA ports
+/// than 256-bit ones, so every ISA level is bound by the best of the levels it includes. Kernels without
+/// arithmetic are compared against the bandwidth alone.
+inline void report_roofline(bm::State &state, roofline_work_t const &work, double seconds) {
+    roofline_ceilings_t const &ceilings = roofline_ceilings();
+    int level = roofline_l1_k;
+    while (level != roofline_ram_k && work.working_set > ceilings.capacity[level])
+        ++level;
+    double bandwidth = ceilings.bandwidth[level];
+    if (level == roofline_l1_k || level == roofline_l2_k)
+        bandwidth *= work.threads;
+    if (level == roofline_ram_k && work.threads > 1)
+        bandwidth = std::min(bandwidth * work.threads, memory_read_bandwidth());
+    double peak = 0;
+    for (int isa = roofline_scalar_k; isa <= work.isa; ++isa)
+        peak = std::max(peak, ceilings.flops[isa][work.scalar_size == sizeof(double)] * work.threads);
+
+    double const intensity = work.operations / work.bytes;
+    double const attainable = work.operations > 0 ? std::min(peak, intensity * bandwidth) : bandwidth;
+    double const achieved = (work.operations > 0 ? work.operations : work.bytes) * state.iterations() / seconds;
+    state.counters["arithmetic_intensity"] = intensity;
+    state.counters["roofline_utilization"] = achieved / attainable;
+}
+
 // ------------------------------------
 // ## Loop Unrolling
 // ------------------------------------
@@ -482,17 +933,30 @@ void f32_matrix_multiplication_4x4_loop_kernel(float a[4][4], float b[4][4], flo
         }
 }
 
+/// Every 4x4 product reads two matrices and writes the third, all of them staying in L1.
+/// With 128 operations per 192 bytes, even the widest kernels should be bound by arithmetic.
+/// The compiler is free to vectorize the plain loops, so they are compared against the widest ISA.
+inline roofline_work_t f32_matrix_multiplication_4x4_work(roofline_isa_t isa) noexcept {
+    roofline_work_t work;
+    work.operations = 4 * 4 * 4 * 2, work.bytes = 3 * 4 * 4 * sizeof(float), work.working_set = work.bytes;
+    work.scalar_size = sizeof(float), work.isa = isa;
+    return work;
+}
+
 static void f32_matrix_multiplication_4x4_loop(bm::State &state) {
     float a[4][4], b[4][4], c[4][4];
     std::iota(&a[0][0], &a[0][0] + 16, 16);
     std::iota(&b[0][0], &b[0][0] + 16, 0);
+    auto start = std::chrono::steady_clock::now();
     for (auto _ : state) {
         f32_matrix_multiplication_4x4_loop_kernel(a, b, c);
         bm::DoNotOptimize(c);
     }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
     std::size_t flops_per_cycle = 4 * 4 * 4 * 2 /* 1 addition and 1 multiplication */;
     state.SetItemsProcessed(flops_per_cycle * state.iterations());
+    report_roofline(state, f32_matrix_multiplication_4x4_work(roofline_widest_k), seconds);
 }
 
 void f32_matrix_multiplication_4x4_loop_unrolled_kernel(float a[4][4], float b[4][4], float c[4][4]) {
@@ -521,13 +985,16 @@ static void f32_matrix_multiplication_4x4_loop_unrolled(bm::State &state) {
     float a[4][4], b[4][4], c[4][4];
     std::iota(&a[0][0], &a[0][0] + 16, 16);
     std::iota(&b[0][0], &b[0][0] + 16, 0);
+    auto start = std::chrono::steady_clock::now();
     for (auto _ : state) {
         f32_matrix_multiplication_4x4_loop_unrolled_kernel(a, b, c);
         bm::DoNotOptimize(c);
     }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
     std::size_t flops_per_cycle = 4 * 4 * 4 * 2 /* 1 addition and 1 multiplication */;
     state.SetItemsProcessed(flops_per_cycle * state.iterations());
+    report_roofline(state, f32_matrix_multiplication_4x4_work(roofline_widest_k), seconds);
 }
 
 #if defined(__SSE2__)
@@ -601,13 +1068,16 @@ static void f32_matrix_multiplication_4x4_loop_sse41(bm::State &state) {
     float a[4][4], b[4][4], c[4][4];
     std::iota(&a[0][0], &a[0][0] + 16, 16);
     std::iota(&b[0][0], &b[0][0] + 16, 0);
+    auto start = std::chrono::steady_clock::now();
     for (auto _ : state) {
         f32_matrix_multiplication_4x4_loop_sse41_kernel(a, b, c);
         bm::DoNotOptimize(c);
     }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
     std::size_t flops_per_cycle = 4 * 4 * 4 * 2 /* 1 addition and 1 multiplication */;
     state.SetItemsProcessed(flops_per_cycle * state.iterations());
+    report_roofline(state, f32_matrix_multiplication_4x4_work(roofline_sse_k), seconds);
 }
 #endif // defined(__SSE2__)
 
@@ -664,16 +1134,21 @@ static void f32_matrix_multiplication_4x4_loop_avx512(bm::State &state) {
     float a[4][4], b[4][4], c[4][4];
     std::iota(&a[0][0], &a[0][0] + 16, 16);
     std::iota(&b[0][0], &b[0][0] + 16, 0);
+    auto start = std::chrono::steady_clock::now();
     for (auto _ : state) {
         f32_matrix_multiplication_4x4_loop_avx512_kernel(a, b, c);
         bm::DoNotOptimize(c);
     }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
     std::size_t flops_per_cycle = 4 * 4 * 4 * 2 /* 1 addition and 1 multiplication */;
     state.SetItemsProcessed(flops_per_cycle * state.iterations());
+    report_roofline(state, f32_matrix_multiplication_4x4_work(roofline_avx512_k), seconds);
 }
 #endif // defined(__AVX512F__)
 
+// The roofline puts the plain loop, that GCC vectorizes, at ~60% of the peak, and the unrolled one at ~10%.
+// A `roofline_utilization` above 1 is a red flag: the AVX-512 kernel only transposes B and never multiplies.
 BENCHMARK(f32_matrix_multiplication_4x4_loop);
 BENCHMARK(f32_matrix_multiplication_4x4_loop_unrolled);
 #if defined(__SSE2__)
@@ -714,17 +1189,181 @@ static void sorting(bm::State &state) {
 BENCHMARK(sorting)->Args({3, false})->Args({3, true});
 BENCHMARK(sorting)->Args({4, false})->Args({4, true});
 
+// Reversed `std::iota` output is also a pattern `std::sort` implementations detect and love.
+// Real columns come in many other shapes, and every sorting benchmark below takes the shape
+// of its input as an argument. The generator is counter-based: every key is a hash of the seed
+// and its own index, so the same seed produces the same dataset, no matter how many threads fill it.
+enum distribution_t : std::int64_t {
+    distribution_uniform_k,       ///< Uniformly random keys over the whole range of the type
+    distribution_sorted_k,        ///< Ascending keys
+    distribution_reversed_k,      ///< Descending keys
+    distribution_organ_pipe_k,    ///< Ascending first half, descending second half
+    distribution_sawtooth_k,      ///< 16 ascending runs
+    distribution_few_unique_k,    ///< Random keys drawn from just 16 distinct values
+    distribution_zipfian_k,       ///< Skewed keys, where small values are much more frequent
+    distribution_nearly_sorted_k, ///< Ascending keys, with a random swap per 1024 keys, inside every 64K-key block
+    distribution_all_equal_k,     ///< The same key repeated `N` times
+    distribution_append_mostly_k, ///< Ascending keys, with the last `N / 64` random, like freshly appended rows
+    distributions_count_k,
+};
+
+inline char const *distribution_name(distribution_t distribution) noexcept {
+    switch (distribution) {
+    case distribution_uniform_k:
+        return "uniform";
+    case distribution_sorted_k:
+        return "sorted";
+    case distribution_reversed_k:
+        return "reversed";
+    case distribution_organ_pipe_k:
+        return "organ_pipe";
+    case distribution_sawtooth_k:
+        return "sawtooth";
+    case distribution_few_unique_k:
+        return "few_unique";
+    case distribution_zipfian_k:
+        return "zipfian";
+    case distribution_nearly_sorted_k:
+        return "nearly_sorted";
+    case distribution_all_equal_k:
+        return "all_equal";
+    case distribution_append_mostly_k:
+        return "append_mostly";
+    default:
+        return "unknown";
+    }
+}
+
+/// All distributions, to be used as one of the dimensions in `ArgsProduct`.
+inline std::vector<std::int64_t> all_distributions() {
+    std::vector<std::int64_t> distributions(distributions_count_k);
+    std::iota(distributions.begin(), distributions.end(), 0);
+    return distributions;
+}
+
+/// SplitMix64 finalizer: a cheap stateless hash, that turns a counter into a random-looking number.
+inline std::uint64_t splitmix64(std::uint64_t x) noexcept {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/// Datasets are generated in slices of this many keys, so that threads can fill them independently.
+/// The random swaps of `distribution_nearly_sorted_k` never cross a slice, so no key moves further than that.
+constexpr std::size_t distribution_slice_k = 1 << 16;
+
+/// @brief  Fills the `[first, last)` slice of a `count`-long dataset. Slices are fully independent.
+template <typename element_at>
+void generate_distribution_slice(element_at *data, std::size_t count, std::size_t first, std::size_t last,
+                                 distribution_t distribution, std::uint64_t seed) noexcept {
+    auto random = [=](std::uint64_t i) noexcept { return splitmix64(seed ^ splitmix64(i)); };
+    auto key = [](std::size_t value) noexcept { return static_cast<element_at>(value); };
+    std::size_t const tooth = std::max<std::size_t>(count / 16, 1);
+    double const universe = static_cast<double>(std::max<std::size_t>(count, 2));
+
+    switch (distribution) {
+    case distribution_uniform_k:
+        for (std::size_t i = first; i != last; ++i)
+            data[i] = static_cast<element_at>(random(i));
+        break;
+    case distribution_sorted_k:
+        for (std::size_t i = first; i != last; ++i)
+            data[i] = key(i);
+        break;
+    case distribution_reversed_k:
+        for (std::size_t i = first; i != last; ++i)
+            data[i] = key(count - i);
+        break;
+    case distribution_organ_pipe_k:
+        for (std::size_t i = first; i != last; ++i)
+            data[i] = key(std::min(i, count - 1 - i));
+        break;
+    case distribution_sawtooth_k:
+        for (std::size_t i = first; i != last; ++i)
+            data[i] = key(i % tooth);
+        break;
+    case distribution_few_unique_k:
+        for (std::size_t i = first; i != last; ++i)
+            data[i] = key(random(i) % 16);
+        break;
+    case distribution_zipfian_k:
+        // For the exponent `s = 1`, the Zipf CDF over ranks `[1, N]` is close to `ln(k) / ln(N)`.
+        // Inverting it turns a uniform `u` from `[0, 1)` into the rank `N^u`, without any tables.
+        for (std::size_t i = first; i != last; ++i) {
+            double const uniform = static_cast<double>(random(i) >> 11) * 0x1.0p-53;
+            data[i] = key(static_cast<std::size_t>(std::pow(universe, uniform)));
+        }
+        break;
+    case distribution_nearly_sorted_k: {
+        for (std::size_t i = first; i != last; ++i)
+            data[i] = key(i);
+        // Swaps stay within the slice, so that slices can be generated independently.
+        std::size_t const length = last - first;
+        std::size_t const swaps = length > 1 ? length / 1024 + 1 : 0;
+        for (std::size_t swap = 0; swap != swaps; ++swap) {
+            std::uint64_t const pair = random(~static_cast<std::uint64_t>(first + swap));
+            std::swap(data[first + (pair & 0xFFFFFFFFu) % length], data[first + (pair >> 32) % length]);
+        }
+        break;
+    }
+    case distribution_all_equal_k:
+        std::fill(data + first, data + last, key(42));
+        break;
+    case distribution_append_mostly_k:
+        for (std::size_t i = first; i != last; ++i)
+            data[i] = i < count - count / 64 ? key(i) : key(random(i) % count);
+        break;
+    default:
+        break;
+    }
+}
+
+/// @brief  Fills `data` with `count` keys of the given distribution, slicing the work between threads.
+template <typename execution_policy_at, typename element_at>
+void generate_distribution(execution_policy_at &&policy, element_at *data, std::size_t count,
+                           distribution_t distribution, std::uint64_t seed = 42) {
+    if (count <= distribution_slice_k)
+        return generate_distribution_slice(data, count, 0, count, distribution, seed);
+#if defined(__cpp_lib_parallel_algorithm)
+    std::vector<std::size_t> slices((count + distribution_slice_k - 1) / distribution_slice_k);
+    std::iota(slices.begin(), slices.end(), 0);
+    std::for_each(policy, slices.begin(), slices.end(), [=](std::size_t slice) {
+        std::size_t const first = slice * distribution_slice_k;
+        generate_distribution_slice(data, count, first, std::min(first + distribution_slice_k, count), distribution,
+                                    seed);
+    });
+#else
+    // Same slices as the parallel path, so that the dataset doesn't depend on the standard library.
+    (void)policy;
+    for (std::size_t first = 0; first < count; first += distribution_slice_k)
+        generate_distribution_slice(data, count, first, std::min(first + distribution_slice_k, count), distribution,
+                                    seed);
+#endif
+}
+
+template <typename element_at>
+void generate_distribution(element_at *data, std::size_t count, distribution_t distribution, std::uint64_t seed = 42) {
+#if defined(__cpp_lib_parallel_algorithm)
+    generate_distribution(std::execution::par_unseq, data, count, distribution, seed);
+#else
+    generate_distribution(nullptr, data, count, distribution, seed);
+#endif
+}
+
 template <bool include_preprocessing_k> static void sorting_template(bm::State &state) {
 
     auto count = static_cast<std::size_t>(state.range(0));
-    std::vector<std::int32_t> array(count);
-    std::iota(array.begin(), array.end(), 1);
+    auto distribution = static_cast<distribution_t>(state.range(1));
+    std::vector<std::int32_t> original(count), array(count);
+    generate_distribution(original.data(), count, distribution);
+    state.SetLabel(distribution_name(distribution));
 
     for (auto _ : state) {
 
         if constexpr (!include_preprocessing_k)
             state.PauseTiming();
-        std::reverse(array.begin(), array.end());
+        std::copy(original.begin(), original.end(), array.begin());
         if constexpr (!include_preprocessing_k)
             state.ResumeTiming();
 
@@ -735,165 +1374,6634 @@ template <bool include_preprocessing_k> static void sorting_template(bm::State &
 
 // Now, our control-flow will not affect the measurements!
 // "Don't pay what you don't use" becomes: "Don't pay for what you can avoid!"
-BENCHMARK_TEMPLATE(sorting_template, false)->Arg(3);
-BENCHMARK_TEMPLATE(sorting_template, true)->Arg(3);
-BENCHMARK_TEMPLATE(sorting_template, false)->Arg(4);
-BENCHMARK_TEMPLATE(sorting_template, true)->Arg(4);
+// The label, reported in the console and in the JSON output, names the input distribution.
+BENCHMARK_TEMPLATE(sorting_template, false)->ArgsProduct({{3, 4}, all_distributions()});
+BENCHMARK_TEMPLATE(sorting_template, true)->ArgsProduct({{3, 4}, all_distributions()});
+
+// Sorting 3 or 4 elements with `std::sort` means branching through the introsort machinery,
+// just to end up in insertion sort. For tiny fixed sizes, "sorting networks" are much better.
+// Those are fixed sequences of compare-exchange operations, that sort any input of a given size.
+// Being data-oblivious, they contain no branches, and the comparisons at the same depth are independent.
+// https://en.wikipedia.org/wiki/Sorting_network
+//
+// We generate them at compile time with the recursive Bose-Nelson construction. It isn't optimal,
+// for 16 elements it uses 65 comparators instead of the best-known 60, but it works for any size.
+// https://doi.org/10.1145/321119.321126
+struct sorting_network_comparator_t {
+    std::uint8_t first = 0, second = 0;
+};
 
-template <typename element_at> //
-struct quick_sort_partition_gt {
-    using element_t = element_at;
+/// @brief  Collects Bose-Nelson comparators. With zero capacity - it only counts them.
+template <std::size_t capacity_ak> struct bose_nelson_builder_gt {
+    std::array<sorting_network_comparator_t, capacity_ak> comparators{};
+    std::size_t count = 0;
 
-    std::int32_t operator()(element_t *arr, std::int32_t low, std::int32_t high) {
-        element_t pivot = arr[high];
-        std::int32_t i = low - 1;
-        for (std::int32_t j = low; j <= high - 1; j++) {
-            if (arr[j] >= pivot)
-                continue;
-            i++;
-            std::swap(arr[i], arr[j]);
+    constexpr void compare_exchange(std::size_t i, std::size_t j) noexcept {
+        if (count < capacity_ak)
+            comparators[count] = {static_cast<std::uint8_t>(i), static_cast<std::uint8_t>(j)};
+        ++count;
+    }
+
+    /// Merges the sorted ranges [i, i + x) and [j, j + y).
+    constexpr void merge(std::size_t i, std::size_t x, std::size_t j, std::size_t y) noexcept {
+        if (x == 1 && y == 1)
+            compare_exchange(i, j);
+        else if (x == 1 && y == 2)
+            compare_exchange(i, j + 1), compare_exchange(i, j);
+        else if (x == 2 && y == 1)
+            compare_exchange(i, j), compare_exchange(i + 1, j);
+        else {
+            std::size_t const a = x / 2, b = (x & 1) ? (y / 2) : ((y + 1) / 2);
+            merge(i, a, j, b);
+            merge(i + a, x - a, j + b, y - b);
+            merge(i + a, x - a, j, b);
         }
-        std::swap(arr[i + 1], arr[high]);
-        return i + 1;
+    }
+
+    /// Sorts the range [i, i + m).
+    constexpr void sort(std::size_t i, std::size_t m) noexcept {
+        if (m < 2)
+            return;
+        std::size_t const a = m / 2;
+        sort(i, a);
+        sort(i + a, m - a);
+        merge(i, a, i + a, m - a);
     }
 };
 
-template <typename element_at> //
-struct quick_sort_recursive_gt {
+template <std::size_t count_ak> constexpr auto bose_nelson_network() noexcept {
+    constexpr std::size_t comparators_count = [] {
+        bose_nelson_builder_gt<0> counter;
+        counter.sort(0, count_ak);
+        return counter.count;
+    }();
+    bose_nelson_builder_gt<comparators_count> builder;
+    builder.sort(0, count_ak);
+    return builder.comparators;
+}
+
+/// By the 0-1 principle, a network sorting all 2^N binary sequences sorts everything.
+template <std::size_t count_ak, std::size_t comparators_ak>
+constexpr bool sorts_binary_inputs(std::array<sorting_network_comparator_t, comparators_ak> const &network) {
+    for (std::size_t input = 0; input != (1u << count_ak); ++input) {
+        std::size_t bits = input;
+        for (auto const &comparator : network) {
+            std::size_t const first = (bits >> comparator.first) & 1u, second = (bits >> comparator.second) & 1u;
+            if (first > second)
+                bits ^= (1u << comparator.first) | (1u << comparator.second);
+        }
+        // Sorted binary sequences look like 0..01..1, so the ones must form a suffix.
+        std::size_t const ones = static_cast<std::size_t>(__builtin_popcountll(bits));
+        if (bits != (((std::size_t(1) << ones) - 1) << (count_ak - ones)))
+            return false;
+    }
+    return true;
+}
+
+static_assert(bose_nelson_network<4>().size() == 5, "Bose-Nelson uses 5 comparators for 4 elements");
+static_assert(sorts_binary_inputs<8>(bose_nelson_network<8>()), "Bose-Nelson network must sort 8 bits");
+
+/// @brief  Applies the network with branchless min/max, fully unrolled at compile time.
+template <typename element_at, std::size_t count_ak> struct sorting_network_scalar_gt {
     using element_t = element_at;
-    using quick_sort_partition_t = quick_sort_partition_gt<element_t>;
-    using quick_sort_recursive_t = quick_sort_recursive_gt<element_t>;
+    static constexpr std::size_t count_k = count_ak;
+    static constexpr auto network_k = bose_nelson_network<count_ak>();
 
-    void operator()(element_t *arr, std::int32_t low, std::int32_t high) {
-        if (low >= high)
-            return;
-        auto pivot = quick_sort_partition_t{}(arr, low, high);
-        quick_sort_recursive_t{}(arr, low, pivot - 1);
-        quick_sort_recursive_t{}(arr, pivot + 1, high);
+    void operator()(element_t *arr) const noexcept { apply_(arr, std::make_index_sequence<network_k.size()>()); }
+
+    /// Sorts the first `count <= count_ak` elements, padding the rest of the network with the largest values.
+    void operator()(element_t *arr, std::size_t count) const noexcept {
+        element_t padded[count_ak];
+        std::fill(std::copy_n(arr, count, padded), padded + count_ak, std::numeric_limits<element_t>::max());
+        operator()(padded);
+        std::copy_n(padded, count, arr);
+    }
+
+  private:
+    template <std::size_t... indices_ak>
+    static void apply_(element_t *arr, std::index_sequence<indices_ak...>) noexcept {
+        (compare_exchange_(arr[network_k[indices_ak].first], arr[network_k[indices_ak].second]), ...);
+    }
+
+    static void compare_exchange_(element_t &a, element_t &b) noexcept {
+        element_t const low = b < a ? b : a, high = b < a ? a : b;
+        a = low, b = high;
     }
 };
 
-template <typename element_at> //
-struct quick_sort_iterative_gt {
-    using element_t = element_at;
-    using quick_sort_partition_t = quick_sort_partition_gt<element_t>;
+/// @brief  Groups the comparators into "layers" of independent comparisons.
+/// Every layer is described by a permutation, mapping each lane onto its partner,
+/// and a bitmask of lanes that must receive the larger of the two values.
+struct sorting_network_layer_t {
+    std::array<std::int32_t, 32> partners{};
+    std::uint32_t upper_lanes = 0;
+};
 
-    std::vector<std::int32_t> stack;
+/// Every comparator can run right after the last comparators touching its two wires.
+template <std::size_t count_ak> constexpr std::size_t sorting_network_depth() noexcept {
+    std::array<std::size_t, count_ak> wire_depths{};
+    std::size_t depth = 0;
+    for (auto const &comparator : bose_nelson_network<count_ak>()) {
+        std::size_t const layer = std::max(wire_depths[comparator.first], wire_depths[comparator.second]);
+        wire_depths[comparator.first] = wire_depths[comparator.second] = layer + 1;
+        depth = std::max(depth, layer + 1);
+    }
+    return depth;
+}
 
-    void operator()(element_t *arr, std::int32_t low, std::int32_t high) {
+template <std::size_t count_ak> constexpr auto sorting_network_layers() noexcept {
+    std::array<sorting_network_layer_t, sorting_network_depth<count_ak>()> layers{};
+    for (auto &layer : layers)
+        for (std::size_t lane = 0; lane != 32; ++lane)
+            layer.partners[lane] = static_cast<std::int32_t>(lane);
+
+    std::array<std::size_t, count_ak> wire_depths{};
+    for (auto const &comparator : bose_nelson_network<count_ak>()) {
+        std::size_t const layer = std::max(wire_depths[comparator.first], wire_depths[comparator.second]);
+        wire_depths[comparator.first] = wire_depths[comparator.second] = layer + 1;
+        layers[layer].partners[comparator.first] = comparator.second;
+        layers[layer].partners[comparator.second] = comparator.first;
+        layers[layer].upper_lanes |= 1u << comparator.second;
+    }
+    return layers;
+}
 
-        stack.resize((high - low + 1) * 2);
-        std::int32_t top = -1;
+#if defined(__AVX512F__)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2", "avx512f", "avx512bw", "avx512vl", "bmi2")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,avx512f,avx512bw,avx512vl,bmi2"))), apply_to = function)
+#endif
 
-        stack[++top] = low;
-        stack[++top] = high;
+/// @brief  Thin wrappers over the AVX-512 intrinsics, to share the same algorithms between 32-bit and 64-bit keys.
+template <typename element_at> struct avx512_lanes_gt;
 
-        while (top >= 0) {
-            high = stack[top--];
-            low = stack[top--];
-            auto pivot = quick_sort_partition_t{}(arr, low, high);
+template <> struct avx512_lanes_gt<std::int32_t> {
+    using element_t = std::int32_t;
+    using vector_t = __m512i;
+    using mask_t = __mmask16;
+    static constexpr std::size_t count_k = 16;
 
-            // If there are elements on left side of pivot,
-            // then push left side to stack
-            if (low < pivot - 1) {
-                stack[++top] = low;
-                stack[++top] = pivot - 1;
-            }
+    static mask_t first(std::size_t count) noexcept { return static_cast<mask_t>(_bzhi_u32(0xFFFFu, count)); }
+    static __m512i broadcast(element_t x) noexcept { return _mm512_set1_epi32(x); }
+    static __m512i load(element_t const *ptr) noexcept { return _mm512_loadu_si512(ptr); }
+    static __m512i load(__m512i fill, mask_t lanes, element_t const *ptr) noexcept {
+        return _mm512_mask_loadu_epi32(fill, lanes, ptr);
+    }
+    static void store(element_t *ptr, __m512i v) noexcept { _mm512_storeu_si512(ptr, v); }
+    static void store(element_t *ptr, mask_t lanes, __m512i v) noexcept { _mm512_mask_storeu_epi32(ptr, lanes, v); }
+    static void compress(element_t *ptr, mask_t lanes, __m512i v) noexcept {
+        _mm512_mask_storeu_epi32(ptr, first(_mm_popcnt_u32(lanes)), _mm512_maskz_compress_epi32(lanes, v));
+    }
+    static mask_t less(__m512i a, __m512i b) noexcept { return _mm512_cmplt_epi32_mask(a, b); }
+    static __m512i indices(std::int32_t const *partners) noexcept { return _mm512_loadu_si512(partners); }
+    static __m512i permute(__m512i a, __m512i indices, __m512i b) noexcept {
+        return _mm512_permutex2var_epi32(a, indices, b);
+    }
+    static __m512i min(__m512i src, mask_t lanes, __m512i a, __m512i b) noexcept {
+        return _mm512_mask_min_epi32(src, lanes, a, b);
+    }
+    static __m512i max(__m512i src, mask_t lanes, __m512i a, __m512i b) noexcept {
+        return _mm512_mask_max_epi32(src, lanes, a, b);
+    }
+};
 
-            // If there are elements on right side of pivot,
-            // then push right side to stack
-            if (pivot + 1 < high) {
-                stack[++top] = pivot + 1;
-                stack[++top] = high;
+template <> struct avx512_lanes_gt<std::int64_t> {
+    using element_t = std::int64_t;
+    using vector_t = __m512i;
+    using mask_t = __mmask8;
+    static constexpr std::size_t count_k = 8;
+
+    static mask_t first(std::size_t count) noexcept { return static_cast<mask_t>(_bzhi_u32(0xFFu, count)); }
+    static __m512i broadcast(element_t x) noexcept { return _mm512_set1_epi64(x); }
+    static __m512i load(element_t const *ptr) noexcept { return _mm512_loadu_si512(ptr); }
+    static __m512i load(__m512i fill, mask_t lanes, element_t const *ptr) noexcept {
+        return _mm512_mask_loadu_epi64(fill, lanes, ptr);
+    }
+    static void store(element_t *ptr, __m512i v) noexcept { _mm512_storeu_si512(ptr, v); }
+    static void store(element_t *ptr, mask_t lanes, __m512i v) noexcept { _mm512_mask_storeu_epi64(ptr, lanes, v); }
+    static void compress(element_t *ptr, mask_t lanes, __m512i v) noexcept {
+        _mm512_mask_storeu_epi64(ptr, first(_mm_popcnt_u32(lanes)), _mm512_maskz_compress_epi64(lanes, v));
+    }
+    static mask_t less(__m512i a, __m512i b) noexcept { return _mm512_cmplt_epi64_mask(a, b); }
+    static __m512i indices(std::int32_t const *partners) noexcept {
+        return _mm512_maskz_cvtepi32_epi64(0xFF, _mm256_loadu_si256(reinterpret_cast<__m256i const *>(partners)));
+    }
+    static __m512i permute(__m512i a, __m512i indices, __m512i b) noexcept {
+        return _mm512_permutex2var_epi64(a, indices, b);
+    }
+    static __m512i min(__m512i src, mask_t lanes, __m512i a, __m512i b) noexcept {
+        return _mm512_mask_min_epi64(src, lanes, a, b);
+    }
+    static __m512i max(__m512i src, mask_t lanes, __m512i a, __m512i b) noexcept {
+        return _mm512_mask_max_epi64(src, lanes, a, b);
+    }
+};
+
+/// @brief  Keeps up to 32 integers in two ZMM registers, and applies a whole layer of the network at once:
+/// a permutation to bring the partners together, then a masked `min` for the lower lanes of every pair,
+/// and a masked `max` for the upper ones.
+/// - `_mm512_permutex2var_epi32` maps to `vpermt2d zmm, zmm, zmm`:
+///      - On Intel Ice Lake: 3 cycle latency, port 5.
+///      - On AMD Zen4: 3 cycle latency, ports: 1 and 2.
+/// - `_mm512_mask_min_epi32` and `_mm512_mask_max_epi32` map to `vpminsd` and `vpmaxsd`, 1 cycle latency.
+template <typename element_at, std::size_t count_ak> struct sorting_network_avx512_gt {
+    using element_t = element_at;
+    using lanes_t = avx512_lanes_gt<element_t>;
+    using mask_t = typename lanes_t::mask_t;
+    static constexpr std::size_t count_k = count_ak;
+    static constexpr auto layers_k = sorting_network_layers<count_ak>();
+    static_assert(count_ak <= lanes_t::count_k * 2, "Only two ZMM registers are used");
+
+    void operator()(element_t *arr) const noexcept { operator()(arr, count_ak); }
+
+    /// Sorts the first `count <= count_ak` elements, padding the rest of the network with the largest values.
+    void operator()(element_t *arr, std::size_t count) const noexcept {
+        constexpr std::size_t register_lanes = lanes_t::count_k;
+        __m512i const padding = lanes_t::broadcast(std::numeric_limits<element_t>::max());
+        if constexpr (count_ak <= register_lanes) {
+            mask_t const lanes = lanes_t::first(count);
+            __m512i values = lanes_t::load(padding, lanes, arr);
+            for (auto const &layer : layers_k) {
+                mask_t const upper = static_cast<mask_t>(layer.upper_lanes);
+                __m512i partners = lanes_t::permute(values, lanes_t::indices(layer.partners.data()), values);
+                __m512i lower_halves = lanes_t::min(values, static_cast<mask_t>(~upper), values, partners);
+                values = lanes_t::max(lower_halves, upper, values, partners);
+            }
+            lanes_t::store(arr, lanes, values);
+        } else {
+            mask_t const low_lanes = lanes_t::first(count);
+            mask_t const high_lanes = lanes_t::first(count > register_lanes ? count - register_lanes : 0);
+            __m512i low = lanes_t::load(padding, low_lanes, arr);
+            __m512i high = lanes_t::load(padding, high_lanes, arr + register_lanes);
+            for (auto const &layer : layers_k) {
+                __m512i low_indices = lanes_t::indices(layer.partners.data());
+                __m512i high_indices = lanes_t::indices(layer.partners.data() + register_lanes);
+                __m512i low_partners = lanes_t::permute(low, low_indices, high);
+                __m512i high_partners = lanes_t::permute(low, high_indices, high);
+                mask_t const low_upper = static_cast<mask_t>(layer.upper_lanes);
+                mask_t const high_upper = static_cast<mask_t>(layer.upper_lanes >> register_lanes);
+                __m512i low_halves = lanes_t::min(low, static_cast<mask_t>(~low_upper), low, low_partners);
+                __m512i high_halves = lanes_t::min(high, static_cast<mask_t>(~high_upper), high, high_partners);
+                low = lanes_t::max(low_halves, low_upper, low, low_partners);
+                high = lanes_t::max(high_halves, high_upper, high, high_partners);
             }
+            lanes_t::store(arr, low_lanes, low);
+            lanes_t::store(arr + register_lanes, high_lanes, high);
         }
     }
 };
 
-template <typename sorter_at, std::int32_t length_ak> //
-static void cost_of_recursion(bm::State &state) {
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif // defined(__AVX512F__)
+
+template <typename sorter_at> static void sorting_network(bm::State &state) {
     using element_t = typename sorter_at::element_t;
+    auto distribution = static_cast<distribution_t>(state.range(0));
+    std::array<element_t, sorter_at::count_k> original, array;
+    generate_distribution(original.data(), original.size(), distribution);
+    state.SetLabel(distribution_name(distribution));
     sorter_at sorter;
-    std::vector<element_t> arr(static_cast<std::size_t>(length_ak));
+
     for (auto _ : state) {
-        for (std::int32_t i = 0; i != length_ak; ++i)
-            arr[i] = length_ak - i;
-        sorter(arr.data(), 0, length_ak - 1);
+        array = original;
+        sorter(array.data());
+        bm::DoNotOptimize(array);
     }
+
+    std::array<element_t, sorter_at::count_k> expected = original;
+    std::sort(expected.begin(), expected.end());
+    if (array != expected)
+        return state.SkipWithError("The network output differs from `std::sort`");
 }
 
-BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_recursive_gt<std::int32_t>, 1024);
-BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_iterative_gt<std::int32_t>, 1024);
-BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_recursive_gt<std::int32_t>, 1024 * 1024);
-BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_iterative_gt<std::int32_t>, 1024 * 1024);
-BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_recursive_gt<std::int32_t>, 1024 * 1024 * 1024);
-BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_iterative_gt<std::int32_t>, 1024 * 1024 * 1024);
+// Compare to `sorting_template<true>`, which also includes the copy in the measurement.
+// The deeper the network, the more independent comparisons the CPU can execute in parallel.
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_scalar_gt<std::int32_t, 3>)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_scalar_gt<std::int32_t, 4>)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_scalar_gt<std::int32_t, 8>)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_scalar_gt<std::int32_t, 32>)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(sorting_template, true)->ArgsProduct({{8, 32}, {distribution_reversed_k}});
+
+// Networks are "data-oblivious": they perform the same comparisons for every input, so their timings
+// stay flat across distributions, while `std::sort` is faster on the patterns it detects.
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_scalar_gt<std::int32_t, 16>)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(sorting_template, true)->ArgsProduct({{16}, all_distributions()});
+
+// The SIMD variant may lose here: the vector load right after the scalar stores of the copy can't
+// be served by store-forwarding, and costs more than the whole scalar network for small sizes.
+// It shines when the values are already in registers, like the sliding windows of a median filter.
+#if defined(__AVX512F__)
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_avx512_gt<std::int32_t, 3>)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_avx512_gt<std::int32_t, 4>)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_avx512_gt<std::int32_t, 8>)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_avx512_gt<std::int32_t, 16>)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(sorting_network, sorting_network_avx512_gt<std::int32_t, 32>)->Arg(distribution_reversed_k);
+#endif
 
-// ------------------------------------
-// ## Now that we know how fast algorithm works - lets scale it!
-// ### And learn the rest of relevant functionality in the process
-// ------------------------------------
+/// Signed indices are needed by the classic Lomuto scheme, which starts at `low - 1`.
+template <typename element_at, typename index_at = std::int32_t> //
+struct quick_sort_partition_gt {
+    using element_t = element_at;
+    using index_t = index_at;
+    static_assert(std::is_signed<index_t>::value, "Partitions step below `low`");
 
-template <typename execution_policy_t> static void super_sort(bm::State &state, execution_policy_t &&policy) {
+    index_t operator()(element_t *arr, index_t low, index_t high) {
+        element_t pivot = arr[high];
+        index_t i = low - 1;
+        for (index_t j = low; j <= high - 1; j++) {
+            if (arr[j] >= pivot)
+                continue;
+            i++;
+            std::swap(arr[i], arr[j]);
+        }
+        std::swap(arr[i + 1], arr[high]);
+        return i + 1;
+    }
+};
 
-    auto count = static_cast<std::size_t>(state.range(0));
-    std::vector<std::int32_t> array(count);
-    std::iota(array.begin(), array.end(), 1);
+/// @brief  Block partition from "BlockQuicksort: How Branch Mispredictions don't affect Quicksort",
+/// by Edelkamp & Weiß: https://arxiv.org/abs/1604.06697
+///
+/// Instead of branching on every comparison, we scan a block of elements from each end, and write down
+/// the offsets of the misplaced ones. The offset is always written, but the counter is only advanced
+/// when the element is misplaced, so the comparison result becomes data, not control flow.
+/// Then the misplaced elements from both sides are exchanged in a single cyclic permutation,
+/// which takes one move per element, instead of three per `std::swap`.
+template <typename element_at, typename index_at = std::int32_t> //
+struct quick_sort_partition_block_gt {
+    using element_t = element_at;
+    using index_t = index_at;
+    static_assert(std::is_signed<index_t>::value, "Partitions step below `low`");
+    static constexpr index_t block_size_k = 128;
 
-    for (auto _ : state) {
-        std::reverse(policy, array.begin(), array.end());
-        std::sort(policy, array.begin(), array.end());
-        bm::DoNotOptimize(array.size());
+    index_t operator()(element_t *arr, index_t low, index_t high) {
+        element_t pivot = arr[high];
+        std::uint8_t offsets_left[block_size_k], offsets_right[block_size_k];
+        index_t count_left = 0, count_right = 0, start_left = 0, start_right = 0;
+
+        // Everything before `left` is smaller than the pivot, everything after `right` isn't.
+        index_t left = low, right = high - 1;
+        while (right - left + 1 > 2 * block_size_k) {
+            if (count_left == 0) {
+                start_left = 0;
+                for (index_t i = 0; i != block_size_k; ++i) {
+                    offsets_left[count_left] = static_cast<std::uint8_t>(i);
+                    count_left += !(arr[left + i] < pivot);
+                }
+            }
+            if (count_right == 0) {
+                start_right = 0;
+                for (index_t i = 0; i != block_size_k; ++i) {
+                    offsets_right[count_right] = static_cast<std::uint8_t>(i);
+                    count_right += arr[right - i] < pivot;
+                }
+            }
+
+            index_t const count = std::min(count_left, count_right);
+            if (count != 0) {
+                std::uint8_t const *lefts = offsets_left + start_left, *rights = offsets_right + start_right;
+                element_t temporary = arr[left + lefts[0]];
+                arr[left + lefts[0]] = arr[right - rights[0]];
+                for (index_t i = 1; i != count; ++i) {
+                    arr[right - rights[i - 1]] = arr[left + lefts[i]];
+                    arr[left + lefts[i]] = arr[right - rights[i]];
+                }
+                arr[right - rights[count - 1]] = temporary;
+            }
+
+            count_left -= count, count_right -= count;
+            start_left += count, start_right += count;
+            if (count_left == 0)
+                left += block_size_k;
+            if (count_right == 0)
+                right -= block_size_k;
+        }
+
+        // At most a few blocks remain unclassified in the middle, so we finish them the Lomuto way.
+        index_t i = left;
+        for (index_t j = left; j <= right; ++j) {
+            if (arr[j] >= pivot)
+                continue;
+            std::swap(arr[i], arr[j]);
+            ++i;
+        }
+        std::swap(arr[i], arr[high]);
+        return i;
     }
+};
 
-    state.SetComplexityN(count);
-    state.SetItemsProcessed(count * state.iterations());
-    state.SetBytesProcessed(count * state.iterations() * sizeof(std::int32_t));
+// Both partition schemes above pivot on `arr[high]`. On sorted or reversed inputs, that's always the
+// smallest or the largest element, so every partition peels off a single element and Quick-Sort
+// degrades to O(N^2) comparisons and O(N) recursion depth. The pivot choice should be pluggable.
 
-    // Feel free to report something else:
-    // state.counters["temperature_on_mars"] = bm::Counter(-95.4);
+template <typename element_at, typename index_at>
+index_at median_of_3_index(element_at const *arr, index_at a, index_at b, index_at c) noexcept {
+    if (arr[a] < arr[b])
+        return arr[b] < arr[c] ? b : (arr[a] < arr[c] ? c : a);
+    return arr[a] < arr[c] ? a : (arr[b] < arr[c] ? c : b);
 }
 
-#ifdef __cpp_lib_parallel_algorithm
+/// Textbook choice, that keeps the old behaviour.
+struct pivot_last_t {
+    template <typename element_at, typename index_at>
+    index_at operator()(element_at const *, index_at, index_at high) const noexcept {
+        return high;
+    }
+};
 
-// Let's try running on 1M to 4B entries.
-// This means input sizes between 4 MB and 16 GB respectively.
-BENCHMARK_CAPTURE(super_sort, seq, std::execution::seq)
-    ->RangeMultiplier(8)
-    ->Range(1l << 20, 1l << 32)
-    ->MinTime(10)
-    ->Complexity(bm::oNLogN);
+/// Median of the first, the middle and the last element. Perfect for sorted and reversed inputs.
+struct pivot_median_of_3_t {
+    template <typename element_at, typename index_at>
+    index_at operator()(element_at const *arr, index_at low, index_at high) const noexcept {
+        return median_of_3_index(arr, low, low + (high - low) / 2, high);
+    }
+};
 
-BENCHMARK_CAPTURE(super_sort, par_unseq, std::execution::par_unseq)
-    ->RangeMultiplier(8)
-    ->Range(1l << 20, 1l << 32)
-    ->MinTime(10)
-    ->Complexity(bm::oNLogN);
+/// Tukey's "ninther" - the median of 3 medians of 3, sampled across the whole range.
+/// It's much harder to fool, than a single median of 3, and is used by pdqsort for large ranges.
+struct pivot_ninther_t {
+    template <typename element_at, typename index_at>
+    index_at operator()(element_at const *arr, index_at low, index_at high) const noexcept {
+        index_at const middle = low + (high - low) / 2;
+        if (high - low < 128)
+            return median_of_3_index(arr, low, middle, high);
+        index_at const step = (high - low) / 8;
+        return median_of_3_index(arr,                                                     //
+                                 median_of_3_index(arr, low, low + step, low + step * 2), //
+                                 median_of_3_index(arr, middle - step, middle, middle + step),
+                                 median_of_3_index(arr, high - step * 2, high - step, high));
+    }
+};
 
-// Without `UseRealTime()`, CPU time is used by default.
-// Difference example: when you sleep your process it is no longer accumulating CPU time.
-BENCHMARK_CAPTURE(super_sort, par_unseq, std::execution::par_unseq)
-    ->RangeMultiplier(8)
-    ->Range(1l << 20, 1l << 32)
-    ->MinTime(10)
-    ->Complexity(bm::oNLogN)
-    ->UseRealTime();
+/// Uniformly random pivot. No fixed input can trigger the worst case, but generating a random number
+/// costs more than the comparisons of a median of 3.
+struct pivot_random_t {
+    template <typename element_at, typename index_at>
+    index_at operator()(element_at const *, index_at low, index_at high) const noexcept {
+        static thread_local std::minstd_rand generator(42);
+        return std::uniform_int_distribution<index_at>(low, high)(generator);
+    }
+};
 
-#endif
+/// Even good pivots can be defeated by crafted inputs. Intro-Sort bounds the recursion depth and
+/// switches to Heap-Sort, which is slower on average, but guarantees O(N log N).
+/// Pattern-Defeating Quick-Sort refines that: it only counts the "bad" partitions, where the smaller
+/// side is shorter than 1/8 of the range, and on every bad partition it swaps a few elements around
+/// to break the pattern, that caused it. https://arxiv.org/abs/2106.05123
+template <typename element_at, typename index_at> //
+struct quick_sort_introspection_gt {
+    using element_t = element_at;
+    using index_t = index_at;
 
-// ------------------------------------
-// ## Calling the benchmarks
-// ------------------------------------
-//
-// The default variant is to invoke the `BENCHMARK_MAIN()` macro.
-// Alternatively, we can unpack it, if we want to augment the main function
+    /// Heap-Sort kicks in after `log2(N)` bad partitions.
+    static index_t depth_limit(index_t low, index_t high) noexcept {
+        return static_cast<index_t>(std::log2(static_cast<double>(high - low + 1))) + 1;
+    }
+
+    static void heap_sort(element_t *arr, index_t low, index_t high) noexcept {
+        std::make_heap(arr + low, arr + high + 1);
+        std::sort_heap(arr + low, arr + high + 1);
+    }
+
+    /// @brief  Checks if the partition was balanced. If not, shuffles both sides and spends the depth budget.
+    /// @return False, if the sides must be finished with Heap-Sort.
+    static bool inspect(element_t *arr, index_t low, index_t pivot, index_t high, index_t &depth_limit) noexcept {
+        index_t const left_size = pivot - low, right_size = high - pivot;
+        if (std::min(left_size, right_size) >= (high - low + 1) / 8)
+            return true;
+        break_patterns_(arr, low, pivot - 1);
+        break_patterns_(arr, pivot + 1, high);
+        return --depth_limit > 0;
+    }
+
+  private:
+    static void break_patterns_(element_t *arr, index_t low, index_t high) noexcept {
+        index_t const size = high - low + 1;
+        if (size < 8)
+            return;
+        index_t const quarter = size / 4, middle = low + size / 2;
+        std::swap(arr[low], arr[low + quarter]);
+        std::swap(arr[high], arr[high - quarter]);
+        std::swap(arr[middle], arr[middle - quarter / 2]);
+    }
+};
+
+template <typename element_at,                                         //
+          typename partition_at = quick_sort_partition_gt<element_at>, //
+          typename pivot_at = pivot_last_t>
+struct quick_sort_recursive_gt {
+    using element_t = element_at;
+    using index_t = typename partition_at::index_t;
+    using quick_sort_partition_t = partition_at;
+    using quick_sort_introspection_t = quick_sort_introspection_gt<element_t, index_t>;
+
+    /// Bytes of call stack used by the last sort, to compare against the explicit stack of the iterative sorter.
+    std::size_t peak_memory_bytes = 0;
+
+    void operator()(element_t *arr, index_t low, index_t high) {
+        if (low >= high)
+            return;
+        char entry_marker;
+        lowest_marker_ = reinterpret_cast<std::uintptr_t>(&entry_marker);
+        sort_(arr, low, high, quick_sort_introspection_t::depth_limit(low, high));
+        peak_memory_bytes = reinterpret_cast<std::uintptr_t>(&entry_marker) - lowest_marker_;
+    }
+
+  private:
+    std::uintptr_t lowest_marker_ = 0;
+
+    void sort_(element_t *arr, index_t low, index_t high, index_t depth_limit) {
+        if (low >= high)
+            return;
+        // The stack grows downwards on all mainstream platforms, so the address of a local
+        // variable in the deepest frame tells how much of the stack we've used.
+        char frame_marker;
+        lowest_marker_ = std::min(lowest_marker_, reinterpret_cast<std::uintptr_t>(&frame_marker));
+        std::swap(arr[pivot_at{}(arr, low, high)], arr[high]);
+        auto pivot = quick_sort_partition_t{}(arr, low, high);
+        if (!quick_sort_introspection_t::inspect(arr, low, pivot, high, depth_limit)) {
+            quick_sort_introspection_t::heap_sort(arr, low, pivot - 1);
+            quick_sort_introspection_t::heap_sort(arr, pivot + 1, high);
+            return;
+        }
+        sort_(arr, low, pivot - 1, depth_limit);
+        sort_(arr, pivot + 1, high, depth_limit);
+    }
+};
+
+template <typename element_at,                                         //
+          typename partition_at = quick_sort_partition_gt<element_at>, //
+          typename pivot_at = pivot_last_t>
+struct quick_sort_iterative_gt {
+    using element_t = element_at;
+    using index_t = typename partition_at::index_t;
+    using quick_sort_partition_t = partition_at;
+    using quick_sort_introspection_t = quick_sort_introspection_gt<element_t, index_t>;
+
+    struct range_t {
+        index_t low, high, depth_limit;
+    };
+
+    /// Bytes of the explicit stack used by the last sort, to compare against the recursive sorter.
+    std::size_t peak_memory_bytes = 0;
+
+    void operator()(element_t *arr, index_t low, index_t high) {
+
+        // We always postpone the larger side, and continue with the smaller one right away.
+        // The smaller side is at most half of the range, so no more than `log2(N)` ranges can be
+        // pending at once. Even for 64-bit indices, that fits into a tiny array on the call stack,
+        // instead of allocating gigabytes on the heap for the worst case.
+        range_t stack[sizeof(index_t) * CHAR_BIT];
+        std::size_t top = 0, peak_top = 0;
+
+        range_t current{low, high, quick_sort_introspection_t::depth_limit(low, high)};
+        while (true) {
+            while (current.low < current.high) {
+                std::swap(arr[pivot_at{}(arr, current.low, current.high)], arr[current.high]);
+                auto pivot = quick_sort_partition_t{}(arr, current.low, current.high);
+                if (!quick_sort_introspection_t::inspect(arr, current.low, pivot, current.high, current.depth_limit)) {
+                    quick_sort_introspection_t::heap_sort(arr, current.low, pivot - 1);
+                    quick_sort_introspection_t::heap_sort(arr, pivot + 1, current.high);
+                    break;
+                }
+
+                range_t left{current.low, pivot - 1, current.depth_limit};
+                range_t right{pivot + 1, current.high, current.depth_limit};
+                bool const left_is_larger = left.high - left.low > right.high - right.low;
+                range_t const &larger = left_is_larger ? left : right;
+                current = left_is_larger ? right : left;
+                if (larger.low < larger.high)
+                    stack[top++] = larger, peak_top = std::max(peak_top, top);
+            }
+            if (top == 0)
+                break;
+            current = stack[--top];
+        }
+        peak_memory_bytes = peak_top * sizeof(range_t);
+    }
+};
+
+template <typename sorter_at, std::size_t length_ak> //
+static void cost_of_recursion(bm::State &state) {
+    using element_t = typename sorter_at::element_t;
+    using index_t = typename sorter_at::index_t;
+    auto distribution = static_cast<distribution_t>(state.range(0));
+    if (!fits_in_memory(length_ak * sizeof(element_t)))
+        return state.SkipWithError("Not enough memory for the keys");
+    sorter_at sorter;
+    std::vector<element_t> arr(length_ak);
+    state.SetLabel(distribution_name(distribution));
+    for (auto _ : state) {
+        // Regenerating in place, instead of copying a pristine version, avoids doubling the
+        // memory footprint for the 4 billion element runs.
+        state.PauseTiming();
+        generate_distribution(arr.data(), length_ak, distribution);
+        state.ResumeTiming();
+        sorter(arr.data(), index_t(0), static_cast<index_t>(length_ak - 1));
+    }
+
+    // Time is only half of the story. Recursion also spends memory on the call stack.
+    state.counters["peak_memory_bytes"] =
+        bm::Counter(static_cast<double>(sorter.peak_memory_bytes), bm::Counter::kDefaults, bm::Counter::OneK::kIs1024);
+}
+
+BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_recursive_gt<std::int32_t>, 1024)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_iterative_gt<std::int32_t>, 1024)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_recursive_gt<std::int32_t>, 1024 * 1024)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_iterative_gt<std::int32_t>, 1024 * 1024)->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_recursive_gt<std::int32_t>, 1024 * 1024 * 1024)
+    ->Arg(distribution_reversed_k);
+BENCHMARK_TEMPLATE(cost_of_recursion, quick_sort_iterative_gt<std::int32_t>, 1024 * 1024 * 1024)
+    ->Arg(distribution_reversed_k);
+
+// With the default `pivot_last_t`, reversed inputs exhaust the depth budget in `log2(N)` partitions,
+// and the sorters fall back to Heap-Sort. Better pivots keep them in Quick-Sort all the way down,
+// so the comparison between recursion and iteration becomes meaningful.
+// No pivot saves the two-way Lomuto partition on `few_unique` and `all_equal` inputs: keys equal
+// to the pivot all land on one side, and only the depth limit keeps those runs from going quadratic.
+BENCHMARK_TEMPLATE(cost_of_recursion,
+                   quick_sort_recursive_gt<std::int32_t, quick_sort_partition_gt<std::int32_t>, pivot_median_of_3_t>,
+                   1024 * 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(cost_of_recursion,
+                   quick_sort_iterative_gt<std::int32_t, quick_sort_partition_gt<std::int32_t>, pivot_median_of_3_t>,
+                   1024 * 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(cost_of_recursion,
+                   quick_sort_recursive_gt<std::int32_t, quick_sort_partition_gt<std::int32_t>, pivot_random_t>,
+                   1024 * 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(cost_of_recursion,
+                   quick_sort_iterative_gt<std::int32_t, quick_sort_partition_gt<std::int32_t>, pivot_random_t>,
+                   1024 * 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(cost_of_recursion,
+                   quick_sort_recursive_gt<std::int32_t, quick_sort_partition_gt<std::int32_t>, pivot_ninther_t>,
+                   1024 * 1024 * 1024)
+    ->Arg(distribution_reversed_k)
+    ->Arg(distribution_uniform_k);
+BENCHMARK_TEMPLATE(cost_of_recursion,
+                   quick_sort_iterative_gt<std::int32_t, quick_sort_partition_gt<std::int32_t>, pivot_ninther_t>,
+                   1024 * 1024 * 1024)
+    ->Arg(distribution_reversed_k)
+    ->Arg(distribution_uniform_k);
+
+// The partition scheme is a template argument, so any of them can be plugged into both sorters.
+BENCHMARK_TEMPLATE(cost_of_recursion,
+                   quick_sort_recursive_gt<std::int32_t, quick_sort_partition_block_gt<std::int32_t>>, 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(cost_of_recursion,
+                   quick_sort_iterative_gt<std::int32_t, quick_sort_partition_block_gt<std::int32_t>>, 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+
+// The custom sorters are templated on the index type, deduced from the partition scheme.
+// 32-bit indices are enough for 2 billion elements and keep the stack frames smaller,
+// while 64-bit indices lift the limit for huge columns, like the 4 billion elements of `super_sort`.
+// Those take 16 GB, and are skipped on machines with less than 32 GB of RAM.
+BENCHMARK_TEMPLATE(
+    cost_of_recursion,
+    quick_sort_iterative_gt<std::int32_t, quick_sort_partition_gt<std::int32_t, std::int64_t>, pivot_ninther_t>,
+    1024ull * 1024 * 1024 * 4)
+    ->Arg(distribution_reversed_k);
+
+// ------------------------------------
+// ## Vectorized Quick-Sort
+// ------------------------------------
+//
+// The `if (arr[j] >= pivot) continue;` in the partition above is a coin flip for random data.
+// Instead of predicting it, we can compare a whole register of keys against the pivot at once,
+// and use the resulting bitmask to move the smaller keys left and the larger keys right.
+//
+// AVX-512 can do that directly with `vpcompressd`, that packs the selected lanes together while storing.
+// AVX2 lacks it, but we can emulate it with a permutation chosen from a 256-entry table, indexed by the mask.
+// https://arxiv.org/abs/1704.08579
+
+/// Scalar fallback for slices too short for the vectorized kernels.
+template <typename element_at>
+std::size_t partition_scalar(element_at *arr, std::size_t count, element_at pivot) noexcept {
+    return static_cast<std::size_t>(std::partition(arr, arr + count, [=](element_at x) { return x < pivot; }) - arr);
+}
+
+/// @brief  In-place partition of `arr` into keys smaller than `pivot`, followed by all the others.
+/// @return The number of keys smaller than `pivot`.
+///
+/// We keep the first and the last register of the input aside, to create room for writing at both ends.
+/// Afterwards, each step loads a register from the side with less room left, so the writes never overtake
+/// the reads. The leftovers are distributed by scalar code.
+template <typename lanes_at>
+std::size_t partition_vectorized(typename lanes_at::element_t *arr, std::size_t count,
+                                 typename lanes_at::element_t pivot) noexcept {
+    using element_t = typename lanes_at::element_t;
+    using vector_t = typename lanes_at::vector_t;
+    constexpr std::size_t width = lanes_at::count_k;
+    if (count < width * 2)
+        return partition_scalar(arr, count, pivot);
+
+    vector_t const pivots = lanes_at::broadcast(pivot);
+    vector_t const first = lanes_at::load(arr), last = lanes_at::load(arr + count - width);
+    std::size_t read_left = width, read_right = count - width;
+    std::size_t write_left = 0, write_right = count;
+    while (read_right - read_left >= width) {
+        vector_t values;
+        if (read_left - write_left <= write_right - read_right)
+            values = lanes_at::load(arr + read_left), read_left += width;
+        else
+            read_right -= width, values = lanes_at::load(arr + read_right);
+        std::size_t const smaller = lanes_at::partition(values, pivots, arr + write_left, arr + write_right);
+        write_left += smaller, write_right -= width - smaller;
+    }
+
+    element_t leftovers[width * 3];
+    std::size_t const leftovers_count = read_right - read_left;
+    std::copy(arr + read_left, arr + read_right, leftovers);
+    lanes_at::store(leftovers + leftovers_count, first);
+    lanes_at::store(leftovers + leftovers_count + width, last);
+    for (std::size_t i = 0; i != leftovers_count + width * 2; ++i)
+        if (leftovers[i] < pivot)
+            arr[write_left++] = leftovers[i];
+        else
+            arr[--write_right] = leftovers[i];
+    return write_left;
+}
+
+#if defined(__AVX512F__)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2", "avx512f", "avx512bw", "avx512vl", "bmi2")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,avx512f,avx512bw,avx512vl,bmi2"))), apply_to = function)
+#endif
+
+/// - `_mm512_maskz_compress_epi32` maps to `vpcompressd zmm {k}{z}, zmm`:
+///      - On Intel Ice Lake: 3 cycle latency, port 5.
+///      - On AMD Zen4: 4 cycle latency, ports: 1 and 2.
+/// The `_mm512_mask_compressstoreu_epi32` form, writing directly to memory, looks more natural, but is
+/// microcoded on AMD Zen4 and takes over 100 cycles. A register compress with a masked store is faster everywhere.
+template <typename element_at> struct partition_avx512_gt : public avx512_lanes_gt<element_at> {
+    using lanes_t = avx512_lanes_gt<element_at>;
+    static std::size_t partition(__m512i values, __m512i pivots, element_at *left, element_at *right_end) noexcept {
+        auto const smaller = lanes_t::less(values, pivots);
+        std::size_t const smaller_count = static_cast<std::size_t>(_mm_popcnt_u32(smaller));
+        lanes_t::compress(left, smaller, values);
+        lanes_t::compress(right_end - (lanes_t::count_k - smaller_count), static_cast<decltype(smaller)>(~smaller),
+                          values);
+        return smaller_count;
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif // defined(__AVX512F__)
+
+#if defined(__AVX2__)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2", "bmi2", "popcnt")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,bmi2,popcnt"))), apply_to = function)
+#endif
+
+/// For every bitmask of "smaller" lanes, lists the 32-bit words of the smaller keys first,
+/// and the rest after them. With 64-bit keys, each key spans 2 consecutive words.
+/// Takes 2 KB for 8x 32-bit lanes, or 128 bytes for 4x 64-bit lanes, and will stay hot in L1.
+template <std::size_t lanes_ak> constexpr auto avx2_partition_permutations() noexcept {
+    constexpr std::size_t words_per_lane = 8 / lanes_ak;
+    std::array<std::array<std::uint8_t, 8>, (1u << lanes_ak)> permutations{};
+    for (std::size_t mask = 0; mask != permutations.size(); ++mask) {
+        std::size_t word = 0;
+        for (bool smaller : {true, false})
+            for (std::size_t lane = 0; lane != lanes_ak; ++lane)
+                if (((mask >> lane) & 1u) == smaller)
+                    for (std::size_t i = 0; i != words_per_lane; ++i)
+                        permutations[mask][word++] = static_cast<std::uint8_t>(lane * words_per_lane + i);
+    }
+    return permutations;
+}
+
+/// Instead of compressing, we permute the smaller keys to the front of the register, and the larger
+/// ones to the back. Then we store the whole register twice - at the left and the right write heads.
+/// The garbage written past the useful lanes lands in the free space and is overwritten later.
+template <typename element_at> struct partition_avx2_gt {
+    using element_t = element_at;
+    using vector_t = __m256i;
+    static constexpr std::size_t count_k = 32 / sizeof(element_t);
+    static constexpr auto permutations_k = avx2_partition_permutations<count_k>();
+
+    static __m256i broadcast(element_t x) noexcept {
+        if constexpr (sizeof(element_t) == 4)
+            return _mm256_set1_epi32(x);
+        else
+            return _mm256_set1_epi64x(x);
+    }
+    static __m256i load(element_t const *ptr) noexcept {
+        return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(ptr));
+    }
+    static void store(element_t *ptr, __m256i v) noexcept { _mm256_storeu_si256(reinterpret_cast<__m256i *>(ptr), v); }
+
+    static std::size_t partition(__m256i values, __m256i pivots, element_t *left, element_t *right_end) noexcept {
+        int smaller;
+        if constexpr (sizeof(element_t) == 4)
+            smaller = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(pivots, values)));
+        else
+            smaller = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(pivots, values)));
+        __m128i const permutation_bytes = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(&permutations_k[smaller]));
+        __m256i const permuted = _mm256_permutevar8x32_epi32(values, _mm256_cvtepu8_epi32(permutation_bytes));
+        store(left, permuted);
+        store(right_end - count_k, permuted);
+        return static_cast<std::size_t>(_mm_popcnt_u32(static_cast<unsigned>(smaller)));
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif // defined(__AVX2__)
+
+/// @brief  Quick-Sort built on a vectorized partition, finishing small slices with a sorting network.
+/// @tparam partition_at    One of the `partition_*_gt` kernels above.
+/// @tparam network_at      Sorting network, that also accepts fewer elements than its size.
+template <typename partition_at, typename network_at> struct quick_sort_vectorized_gt {
+    using element_t = typename network_at::element_t;
+    using index_t = std::ptrdiff_t;
+
+    void operator()(element_t *arr, index_t low, index_t high) const noexcept {
+        std::size_t const count = static_cast<std::size_t>(high - low + 1);
+        // Similar to Intro-Sort, bail out to `std::sort` if the pivots keep failing us
+        std::size_t const depth_limit = 2 * static_cast<std::size_t>(std::log2(count + 1));
+        sort_(arr + low, count, depth_limit);
+    }
+
+  private:
+    static void sort_(element_t *arr, std::size_t count, std::size_t depth_limit) noexcept {
+        while (count > network_at::count_k) {
+            if (depth_limit-- == 0)
+                return std::sort(arr, arr + count);
+
+            element_t const a = arr[0], b = arr[count / 2], c = arr[count - 1];
+            element_t const pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+            std::size_t split = partition_vectorized<partition_at>(arr, count, pivot);
+
+            // The pivot is the median of 3 keys, so only the left side can be empty.
+            // That means the pivot is the smallest key, so we gather its copies and skip them.
+            if (split == 0) {
+                if (pivot == std::numeric_limits<element_t>::max())
+                    return;
+                split = partition_vectorized<partition_at>(arr, count, pivot + 1);
+                arr += split, count -= split;
+                continue;
+            }
+
+            // Recurse into the smaller side and loop over the larger one, to keep the stack shallow.
+            if (split < count - split)
+                sort_(arr, split, depth_limit), arr += split, count -= split;
+            else
+                sort_(arr + split, count - split, depth_limit), count = split;
+        }
+        network_at{}(arr, count);
+    }
+};
+
+/// Adapts `std::sort` to the same interface as the custom sorters above.
+template <typename element_at> struct std_sort_gt {
+    using element_t = element_at;
+    using index_t = std::ptrdiff_t;
+    void operator()(element_t *arr, index_t low, index_t high) const noexcept { std::sort(arr + low, arr + high + 1); }
+};
+
+template <typename sorter_at, std::size_t length_ak> //
+static void sorting_distribution(bm::State &state) {
+    using element_t = typename sorter_at::element_t;
+    using index_t = typename sorter_at::index_t;
+    auto distribution = static_cast<distribution_t>(state.range(0));
+    sorter_at sorter;
+    std::vector<element_t> original(length_ak), arr(length_ak);
+    generate_distribution(original.data(), length_ak, distribution);
+    state.SetLabel(distribution_name(distribution));
+
+    for (auto _ : state) {
+        // Pausing the timer costs ~100 ns, but is negligible compared to sorting millions of keys.
+        state.PauseTiming();
+        std::copy(original.begin(), original.end(), arr.begin());
+        state.ResumeTiming();
+        sorter(arr.data(), index_t(0), static_cast<index_t>(length_ak - 1));
+        bm::DoNotOptimize(arr.data());
+    }
+    std::sort(original.begin(), original.end());
+    if (arr != original)
+        return state.SkipWithError("The result differs from `std::sort`");
+    state.SetItemsProcessed(length_ak * state.iterations());
+    state.SetBytesProcessed(length_ak * state.iterations() * sizeof(element_t));
+}
+
+// The branchy Lomuto partition mispredicts on half of the elements of random inputs,
+// while the vectorized ones are branchless in their hot loop.
+BENCHMARK_TEMPLATE(sorting_distribution, quick_sort_recursive_gt<std::int32_t>, 1024 * 1024)
+    ->Arg(distribution_uniform_k);
+BENCHMARK_TEMPLATE(sorting_distribution,
+                   quick_sort_recursive_gt<std::int32_t, quick_sort_partition_block_gt<std::int32_t>>, 1024 * 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(sorting_distribution, std_sort_gt<std::int32_t>, 1024 * 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(sorting_distribution, std_sort_gt<std::int64_t>, 1024 * 1024)->Arg(distribution_uniform_k);
+
+// Does the narrower index help? Both variants share the same code, but 64-bit indices
+// make every stack frame and every pending range twice as large, and don't fit as many
+// offsets into a register in the block partition.
+BENCHMARK_TEMPLATE(
+    sorting_distribution,
+    quick_sort_iterative_gt<std::int32_t, quick_sort_partition_block_gt<std::int32_t, std::int32_t>, pivot_ninther_t>,
+    1024)
+    ->Arg(distribution_uniform_k);
+BENCHMARK_TEMPLATE(
+    sorting_distribution,
+    quick_sort_iterative_gt<std::int32_t, quick_sort_partition_block_gt<std::int32_t, std::int64_t>, pivot_ninther_t>,
+    1024)
+    ->Arg(distribution_uniform_k);
+BENCHMARK_TEMPLATE(
+    sorting_distribution,
+    quick_sort_iterative_gt<std::int32_t, quick_sort_partition_block_gt<std::int32_t, std::int32_t>, pivot_ninther_t>,
+    1024 * 1024)
+    ->Arg(distribution_uniform_k);
+BENCHMARK_TEMPLATE(
+    sorting_distribution,
+    quick_sort_iterative_gt<std::int32_t, quick_sort_partition_block_gt<std::int32_t, std::int64_t>, pivot_ninther_t>,
+    1024 * 1024)
+    ->Arg(distribution_uniform_k);
+
+#if defined(__AVX2__)
+BENCHMARK_TEMPLATE(sorting_distribution,
+                   quick_sort_vectorized_gt<partition_avx2_gt<std::int32_t>, //
+                                            sorting_network_scalar_gt<std::int32_t, 16>>,
+                   1024 * 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(sorting_distribution,
+                   quick_sort_vectorized_gt<partition_avx2_gt<std::int64_t>, //
+                                            sorting_network_scalar_gt<std::int64_t, 16>>,
+                   1024 * 1024)
+    ->Arg(distribution_uniform_k);
+#endif
+#if defined(__AVX512F__)
+BENCHMARK_TEMPLATE(sorting_distribution,
+                   quick_sort_vectorized_gt<partition_avx512_gt<std::int32_t>, //
+                                            sorting_network_avx512_gt<std::int32_t, 32>>,
+                   1024 * 1024)
+    ->DenseRange(0, distributions_count_k - 1);
+BENCHMARK_TEMPLATE(sorting_distribution,
+                   quick_sort_vectorized_gt<partition_avx512_gt<std::int64_t>, //
+                                            sorting_network_avx512_gt<std::int64_t, 16>>,
+                   1024 * 1024)
+    ->Arg(distribution_uniform_k);
+#endif
+
+// ------------------------------------
+// ## Now that we know how fast algorithm works - lets scale it!
+// ### And learn the rest of relevant functionality in the process
+// ------------------------------------
+
+template <typename execution_policy_t> static void super_sort(bm::State &state, execution_policy_t &&policy) {
+
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto distribution = static_cast<distribution_t>(state.range(1));
+    std::vector<std::int32_t> array(count);
+    state.SetLabel(distribution_name(distribution));
+
+    for (auto _ : state) {
+        // Unlike reversal, generation doesn't depend on the previous state of the array, but it isn't free:
+        // the zipfian generator calls `std::pow` for every element. So it is excluded from the timing.
+        state.PauseTiming();
+        generate_distribution(policy, array.data(), count, distribution);
+        state.ResumeTiming();
+        std::sort(policy, array.begin(), array.end());
+        bm::DoNotOptimize(array.size());
+    }
+
+    state.SetComplexityN(count);
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(count * state.iterations() * sizeof(std::int32_t));
+
+    // Feel free to report something else:
+    // state.counters["temperature_on_mars"] = bm::Counter(-95.4);
+}
+
+#ifdef __cpp_lib_parallel_algorithm
+
+// Let's try running on 1M to 4B entries.
+// This means input sizes between 4 MB and 16 GB respectively.
+// The complexity is fitted over all the runs of a registration, so we keep one distribution per sweep.
+BENCHMARK_CAPTURE(super_sort, seq, std::execution::seq)
+    ->ArgsProduct({bm::CreateRange(1l << 20, 1l << 32, 8), {distribution_reversed_k}})
+    ->MinTime(10)
+    ->Complexity(bm::oNLogN);
+
+BENCHMARK_CAPTURE(super_sort, par_unseq, std::execution::par_unseq)
+    ->ArgsProduct({bm::CreateRange(1l << 20, 1l << 32, 8), {distribution_reversed_k}})
+    ->MinTime(10)
+    ->Complexity(bm::oNLogN);
+
+// Without `UseRealTime()`, CPU time is used by default.
+// Difference example: when you sleep your process it is no longer accumulating CPU time.
+BENCHMARK_CAPTURE(super_sort, par_unseq, std::execution::par_unseq)
+    ->ArgsProduct({bm::CreateRange(1l << 20, 1l << 32, 8), {distribution_reversed_k}})
+    ->MinTime(10)
+    ->Complexity(bm::oNLogN)
+    ->UseRealTime();
+
+// Every distribution on a fixed 16M-entry input, or 64 MB, well beyond the caches.
+BENCHMARK_CAPTURE(super_sort, seq, std::execution::seq)->ArgsProduct({{1l << 24}, all_distributions()})->MinTime(10);
+BENCHMARK_CAPTURE(super_sort, par_unseq, std::execution::par_unseq)
+    ->ArgsProduct({{1l << 24}, all_distributions()})
+    ->MinTime(10)
+    ->UseRealTime();
+
+#endif
+
+// Sorts that need scratch memory tend to allocate it on every call: merge buffers, radix histograms,
+// stacks of pending runs. For a single huge sort that is noise, but a service sorting thousands of
+// small batches per second spends a visible share of its time in `malloc` and `free`, and in the page faults
+// of freshly mapped memory. The buffered sorts below borrow their scratch memory from a
+// `std::pmr::memory_resource` instead, so the caller decides where it comes from, and how long it lives.
+
+/// @brief  A thread-safe monotonic arena: allocations bump an atomic offset inside one reusable block,
+///         deallocations are no-ops, and `reset` rewinds everything at once, between two sorts.
+///         `std::pmr::monotonic_buffer_resource` does the same, but can't be shared between threads.
+///         Requests that don't fit go to the `upstream` resource, and the next `reset` grows the block
+///         to the total demand, so a steady workload stops touching the heap after the first round.
+class arena_resource_t : public std::pmr::memory_resource {
+  public:
+    explicit arena_resource_t(std::pmr::memory_resource *upstream = std::pmr::get_default_resource()) noexcept
+        : upstream_(upstream) {}
+    ~arena_resource_t() noexcept override {
+        release_overflows_();
+        if (block_)
+            upstream_->deallocate(block_, capacity_, block_alignment_k);
+    }
+    arena_resource_t(arena_resource_t const &) = delete;
+    arena_resource_t &operator=(arena_resource_t const &) = delete;
+
+    /// Invalidates all previous allocations. Must not overlap with any allocations from other threads.
+    void reset() {
+        std::size_t const demand = offset_.load(std::memory_order_relaxed);
+        release_overflows_();
+        if (demand > capacity_) {
+            if (block_)
+                upstream_->deallocate(block_, capacity_, block_alignment_k);
+            block_ = nullptr, capacity_ = 0;
+            block_ = static_cast<std::byte *>(upstream_->allocate(demand, block_alignment_k));
+            capacity_ = demand;
+        }
+        offset_.store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t capacity() const noexcept { return capacity_; }
+
+  private:
+    static constexpr std::size_t block_alignment_k = 64;
+
+    struct overflow_t {
+        void *pointer;
+        std::size_t bytes;
+        std::size_t alignment;
+    };
+
+    std::pmr::memory_resource *upstream_;
+    std::byte *block_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::atomic<std::size_t> offset_{0}; ///< Keeps growing past the `capacity_`, to measure the demand
+    std::mutex overflows_mutex_;
+    std::vector<overflow_t> overflows_;
+
+    void release_overflows_() noexcept {
+        for (overflow_t const &overflow : overflows_)
+            upstream_->deallocate(overflow.pointer, overflow.bytes, overflow.alignment);
+        overflows_.clear();
+    }
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        // Reserving `alignment - 1` extra bytes guarantees an aligned address inside the reservation.
+        std::size_t const reserved = bytes + alignment - 1;
+        std::size_t const offset = offset_.fetch_add(reserved, std::memory_order_relaxed);
+        if (offset + reserved <= capacity_) {
+            auto const address = reinterpret_cast<std::uintptr_t>(block_ + offset);
+            return block_ + offset + ((alignment - address % alignment) % alignment);
+        }
+        void *pointer = upstream_->allocate(bytes, alignment);
+        std::lock_guard<std::mutex> lock(overflows_mutex_);
+        overflows_.push_back({pointer, bytes, alignment});
+        return pointer;
+    }
+    void do_deallocate(void *, std::size_t, std::size_t) noexcept override {}
+    bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override { return this == &other; }
+};
+
+/// Forwards everything to the `upstream` resource, counting the allocations on the way. Thread-safe.
+class counting_resource_t : public std::pmr::memory_resource {
+  public:
+    explicit counting_resource_t(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource()) noexcept
+        : upstream_(upstream) {}
+
+    std::size_t allocations() const noexcept { return allocations_.load(std::memory_order_relaxed); }
+    std::size_t bytes() const noexcept { return bytes_.load(std::memory_order_relaxed); }
+
+  private:
+    std::pmr::memory_resource *upstream_;
+    std::atomic<std::size_t> allocations_{0};
+    std::atomic<std::size_t> bytes_{0};
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        allocations_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        return upstream_->allocate(bytes, alignment);
+    }
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) override {
+        upstream_->deallocate(pointer, bytes, alignment);
+    }
+    bool do_is_equal(std::pmr::memory_resource const &other) const noexcept override { return this == &other; }
+};
+
+/// @brief  An uninitialized array, borrowed from a memory resource for the duration of one call.
+///         Unlike `std::pmr::vector`, it doesn't zero-initialize gigabytes of memory, just to overwrite them.
+template <typename element_at> class scratch_buffer_gt {
+    static_assert(std::is_trivially_default_constructible<element_at>::value, "Elements are left uninitialized");
+    static_assert(std::is_trivially_destructible<element_at>::value, "Elements are never destroyed");
+
+  public:
+    scratch_buffer_gt(std::size_t count, std::pmr::memory_resource *resource)
+        : resource_(resource), count_(count),
+          data_(static_cast<element_at *>(resource->allocate(count * sizeof(element_at), alignof(element_at)))) {}
+    ~scratch_buffer_gt() noexcept { resource_->deallocate(data_, count_ * sizeof(element_at), alignof(element_at)); }
+    scratch_buffer_gt(scratch_buffer_gt const &) = delete;
+    scratch_buffer_gt &operator=(scratch_buffer_gt const &) = delete;
+
+    element_at *data() const noexcept { return data_; }
+
+  private:
+    std::pmr::memory_resource *resource_;
+    std::size_t count_;
+    element_at *data_;
+};
+
+// `std::sort` has to assume nothing about its input, but real columns are often partially sorted already:
+// time series are appended mostly in order, and yesterday's sorted table gets a small batch of new rows.
+// An adaptive front-end scans the input once, finds the ascending and descending runs, reverses the latter,
+// and merges neighbors. A single run costs just O(N), and `R` runs cost O(N log R).
+// The merge order follows Powersort, which provably stays within a few percent of the optimal merge tree.
+// Stretches of short runs are not worth tracking, so they are sorted with the general algorithm instead.
+// https://arxiv.org/abs/1805.04154
+
+/// @brief  Run-detecting sort: merges long natural runs Powersort-style, and falls back to `std::sort`
+///         for the stretches in between. Like `std::sort`, it is not stable.
+template <typename element_at, typename less_at = std::less<element_at>> class adaptive_sort_gt {
+  public:
+    using element_t = element_at;
+    using less_t = less_at;
+
+    /// Shorter runs are glued together with their neighbors and sorted with the general algorithm.
+    static constexpr std::size_t min_run_k = 64;
+
+    explicit adaptive_sort_gt(std::pmr::memory_resource *resource = std::pmr::get_default_resource(),
+                              less_t less = {}) noexcept
+        : resource_(resource), less_(less) {}
+
+    /// Sorts `[begin, end)`, passing the `policy` to `std::sort` for the stretches without long runs.
+    template <typename execution_policy_at>
+    void operator()(execution_policy_at &&policy, element_t *begin, element_t *end) {
+        std::size_t const count = static_cast<std::size_t>(end - begin);
+        merger_t merger(begin, count, less_, resource_);
+
+        std::size_t unsorted_begin = 0, i = 0;
+        while (i != count) {
+            bool descending = false;
+            std::size_t const run_end = merger.find_run(i, descending);
+            if (run_end - i < min_run_k && run_end != count) {
+                i = run_end;
+                continue;
+            }
+            if (run_end - i < min_run_k)
+                i = run_end; // The trailing short run joins the unsorted stretch
+            if (unsorted_begin != i) {
+                std::sort(policy, begin + unsorted_begin, begin + i, less_);
+                merger.push_run(unsorted_begin, i);
+            }
+            if (i != run_end) {
+                if (descending)
+                    std::reverse(begin + i, begin + run_end);
+                merger.push_run(i, run_end);
+            }
+            unsorted_begin = i = run_end;
+        }
+        while (merger.runs.size() > 1)
+            merger.merge_top();
+        runs_count_ = merger.runs_count;
+    }
+
+    /// Sorts `[begin, end)` on the calling thread.
+    void operator()(element_t *begin, element_t *end) { (*this)(std::execution::seq, begin, end); }
+
+    /// The number of runs the last call has merged, including the sorted stretches.
+    std::size_t runs_count() const noexcept { return runs_count_; }
+
+  private:
+    struct run_t {
+        std::size_t begin;
+        std::size_t end;
+        int power; ///< Depth of the boundary with the next run in the Powersort merge tree
+    };
+
+    /// The state of a single call: the stack of pending runs, and the merge buffer.
+    struct merger_t {
+        element_t *data;
+        std::size_t count;
+        less_t const &less;
+        std::pmr::vector<run_t> runs;
+        std::pmr::vector<element_t> buffer;
+        std::size_t runs_count = 0;
+
+        merger_t(element_t *data, std::size_t count, less_t const &less, std::pmr::memory_resource *resource)
+            : data(data), count(count), less(less), runs(resource), buffer(resource) {}
+
+        /// Returns the end of the run starting at `first`. Descending runs must be strict, to avoid swapping equals.
+        std::size_t find_run(std::size_t first, bool &descending) const noexcept {
+            std::size_t last = first + 1;
+            if (last == count)
+                return last;
+            descending = less(data[last], data[first]);
+            if (descending)
+                while (last != count && less(data[last], data[last - 1]))
+                    ++last;
+            else
+                while (last != count && !less(data[last], data[last - 1]))
+                    ++last;
+            return last;
+        }
+
+        /// The most significant bit, where the midpoints of two neighboring runs differ, scaled to `[0, 1)`.
+        int boundary_power(run_t const &left, run_t const &right) const noexcept {
+            std::size_t a = left.begin + left.end, b = right.begin + right.end;
+            int power = 0;
+            for (;;) {
+                ++power;
+                if (a >= count)
+                    a -= count, b -= count;
+                else if (b >= count)
+                    break;
+                a <<= 1, b <<= 1;
+            }
+            return power;
+        }
+
+        void push_run(std::size_t first, std::size_t last) {
+            run_t run{first, last, 0};
+            ++runs_count;
+            if (!runs.empty()) {
+                int const power = boundary_power(runs.back(), run);
+                while (runs.size() > 1 && runs[runs.size() - 2].power > power)
+                    merge_top();
+                runs.back().power = power;
+            }
+            runs.push_back(run);
+        }
+
+        /// Merges the two topmost runs, after trimming the elements that are already in place.
+        void merge_top() {
+            run_t right = runs.back();
+            runs.pop_back();
+            run_t &left = runs.back();
+            element_t *first = data + left.begin, *middle = data + right.begin, *last = data + right.end;
+            left.end = right.end;
+
+            // Appending to a sorted column often leaves both ends untouched: skip them with binary searches.
+            first = std::upper_bound(first, middle, *middle, less);
+            last = std::lower_bound(middle, last, middle[-1], less);
+            if (first == middle || middle == last)
+                return;
+
+            // Only the shorter side is moved into the buffer, and we merge towards the other end.
+            // The output never overtakes the unread part of the longer side, so no other memory is needed.
+            if (middle - first <= last - middle) {
+                buffer.assign(first, middle);
+                element_t *buffered = buffer.data(), *buffered_end = buffered + buffer.size();
+                while (buffered != buffered_end && middle != last)
+                    *first++ = less(*middle, *buffered) ? *middle++ : *buffered++;
+                std::copy(buffered, buffered_end, first);
+            } else {
+                buffer.assign(middle, last);
+                element_t *buffered_begin = buffer.data(), *buffered = buffered_begin + buffer.size();
+                while (buffered != buffered_begin && middle != first)
+                    *--last = less(buffered[-1], middle[-1]) ? *--middle : *--buffered;
+                std::copy_backward(buffered_begin, buffered, last);
+            }
+        }
+    };
+
+    std::pmr::memory_resource *resource_;
+    less_t less_;
+    std::size_t runs_count_ = 0;
+};
+
+template <typename execution_policy_t> static void super_sort_adaptive(bm::State &state, execution_policy_t &&policy) {
+
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto distribution = static_cast<distribution_t>(state.range(1));
+    if (!fits_in_memory(2 * count * sizeof(std::int32_t)))
+        return state.SkipWithError("Not enough memory for the keys and the merge buffer");
+    std::vector<std::int32_t> array(count);
+    state.SetLabel(distribution_name(distribution));
+    arena_resource_t arena;
+    adaptive_sort_gt<std::int32_t> sorter(&arena);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        generate_distribution(policy, array.data(), count, distribution);
+        state.ResumeTiming();
+        sorter(policy, array.data(), array.data() + count);
+        arena.reset();
+        bm::DoNotOptimize(array.size());
+    }
+    if (!std::is_sorted(policy, array.begin(), array.end()))
+        return state.SkipWithError("The keys are not sorted");
+
+    state.SetComplexityN(count);
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(count * state.iterations() * sizeof(std::int32_t));
+    state.counters["runs"] = static_cast<double>(sorter.runs_count());
+}
+
+#ifdef __cpp_lib_parallel_algorithm
+
+// A reversed input is a single descending run, so the sort becomes a reversal, and the complexity is linear.
+// At 4B keys, the 32-bit keys wrap around, and the input is two descending runs, that also need a merge.
+// Sizes, for which the merge buffer doesn't fit next to the keys, are skipped.
+// Compare the other distributions with the `super_sort` runs above: random inputs pay for one extra scan,
+// while the sorted, reversed, organ-pipe, sawtooth, nearly-sorted, and append-mostly ones get 3-20x faster.
+BENCHMARK_CAPTURE(super_sort_adaptive, seq, std::execution::seq)
+    ->ArgsProduct({bm::CreateRange(1l << 20, 1l << 32, 8), {distribution_reversed_k}})
+    ->MinTime(10)
+    ->Complexity(bm::oN);
+BENCHMARK_CAPTURE(super_sort_adaptive, seq, std::execution::seq)
+    ->ArgsProduct({{1l << 24}, all_distributions()})
+    ->MinTime(10);
+BENCHMARK_CAPTURE(super_sort_adaptive, par_unseq, std::execution::par_unseq)
+    ->ArgsProduct({{1l << 24}, all_distributions()})
+    ->MinTime(10)
+    ->UseRealTime();
+
+#endif
+
+// Columns of bare integers are rare. More often we sort records by one of their fields,
+// or produce a permutation to apply to several columns later, like `numpy.argsort`.
+// Sorting records directly moves whole records at every level of the sort, so its cost grows with
+// the record size. Sorting (key, index) pairs instead moves 8 bytes per record at every level, and
+// then the final "gather" moves every record just once, but in a random order.
+
+/// A record with a 32-bit key, padded with payload up to `size_ak` bytes.
+template <std::size_t size_ak> struct record_gt {
+    static_assert(size_ak > sizeof(std::int32_t), "The record must have a payload");
+    std::int32_t key;
+    std::uint8_t payload[size_ak - sizeof(std::int32_t)];
+};
+
+static_assert(sizeof(record_gt<8>) == 8 && sizeof(record_gt<128>) == 128, "Records must have no padding");
+
+template <std::size_t size_ak> std::vector<record_gt<size_ak>> make_records(std::size_t count) {
+    std::vector<std::int32_t> keys(count);
+    generate_distribution(keys.data(), count, distribution_uniform_k);
+    std::vector<record_gt<size_ak>> records(count);
+    for (std::size_t i = 0; i != count; ++i) {
+        records[i].key = keys[i];
+        std::memset(records[i].payload, static_cast<int>(i & 0xFF), sizeof(records[i].payload));
+    }
+    return records;
+}
+
+/// @return Whether the last sorted copy is ordered by the key.
+template <std::size_t size_ak, typename execution_policy_t>
+static bool sort_records_directly(bm::State &state, execution_policy_t &&policy, std::size_t count) {
+    using record_t = record_gt<size_ak>;
+    auto const original = make_records<size_ak>(count);
+    std::vector<record_t> records(count);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::copy(policy, original.begin(), original.end(), records.begin());
+        state.ResumeTiming();
+        std::sort(policy, records.begin(), records.end(),
+                  [](record_t const &a, record_t const &b) { return a.key < b.key; });
+        bm::DoNotOptimize(records.data());
+    }
+    return std::is_sorted(records.begin(), records.end(),
+                          [](record_t const &a, record_t const &b) { return a.key < b.key; });
+}
+
+/// @return Whether the last gathered copy is ordered by the key, keeps the ties in their original order,
+///         and holds exactly the records the permutation points to.
+template <std::size_t size_ak, typename execution_policy_t>
+static bool sort_records_indirectly(bm::State &state, execution_policy_t &&policy, std::size_t count) {
+    using record_t = record_gt<size_ak>;
+    auto const records = make_records<size_ak>(count);
+    std::vector<std::uint32_t> indices(count);
+    std::iota(indices.begin(), indices.end(), 0u);
+    std::vector<std::uint64_t> pairs(count);
+    std::vector<record_t> sorted(count);
+
+    for (auto _ : state) {
+        // Flipping the sign bit preserves the order of signed keys in the top half of an unsigned integer,
+        // and the index in the bottom half breaks the ties, making the whole procedure stable.
+        std::transform(policy, indices.begin(), indices.end(), pairs.begin(), [&](std::uint32_t i) {
+            auto key = static_cast<std::uint32_t>(records[i].key) ^ 0x80000000u;
+            return (static_cast<std::uint64_t>(key) << 32) | i;
+        });
+        std::sort(policy, pairs.begin(), pairs.end());
+        std::transform(policy, pairs.begin(), pairs.end(), sorted.begin(),
+                       [&](std::uint64_t pair) { return records[static_cast<std::uint32_t>(pair)]; });
+        bm::DoNotOptimize(sorted.data());
+    }
+
+    // With the index in the low half, strictly increasing pairs mean both sorted keys and stable ties.
+    for (std::size_t j = 0; j != count; ++j) {
+        auto const i = static_cast<std::uint32_t>(pairs[j]);
+        auto const key = static_cast<std::uint32_t>(records[i].key) ^ 0x80000000u;
+        if ((j && pairs[j - 1] >= pairs[j]) || static_cast<std::uint32_t>(pairs[j] >> 32) != key ||
+            std::memcmp(&sorted[j], &records[i], sizeof(record_t)) != 0)
+            return false;
+    }
+    return true;
+}
+
+/// The record size is a template argument, so every size gets its own registration and its own instantiation
+/// of the sort, with the comparator and the record moves inlined for that size.
+template <std::size_t size_ak, typename execution_policy_at> static void sorting_records(bm::State &state) {
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto indirect = static_cast<bool>(state.range(1));
+    execution_policy_at policy{};
+    bool const sorted = indirect ? sort_records_indirectly<size_ak>(state, policy, count)
+                                 : sort_records_directly<size_ak>(state, policy, count);
+    if (!sorted)
+        return state.SkipWithError(indirect ? "The records are not sorted or not stable"
+                                            : "The records are not sorted");
+    state.SetLabel(indirect ? "argsort+gather" : "direct");
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(count * state.iterations() * size_ak);
+}
+
+static void sorting_records_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgsProduct({{1 << 16, 1 << 20, 1 << 24}, {false, true}})->ArgNames({"count", "indirect"});
+}
+
+#ifdef __cpp_lib_parallel_algorithm
+
+// Compare the runs with the same record size and `count`: the first size at which `indirect:1` is faster
+// is the crossover. It depends on the caches, the memory bandwidth and the core count, so measure it
+// on the machine you care about, rather than assuming a fixed threshold.
+BENCHMARK(sorting_records<8, std::execution::sequenced_policy>)->Apply(sorting_records_arguments);
+BENCHMARK(sorting_records<16, std::execution::sequenced_policy>)->Apply(sorting_records_arguments);
+BENCHMARK(sorting_records<32, std::execution::sequenced_policy>)->Apply(sorting_records_arguments);
+BENCHMARK(sorting_records<64, std::execution::sequenced_policy>)->Apply(sorting_records_arguments);
+BENCHMARK(sorting_records<128, std::execution::sequenced_policy>)->Apply(sorting_records_arguments);
+
+// With many threads sharing the memory bus, moving fewer bytes matters even more.
+BENCHMARK(sorting_records<8, std::execution::parallel_unsequenced_policy>)
+    ->Apply(sorting_records_arguments)
+    ->UseRealTime();
+BENCHMARK(sorting_records<16, std::execution::parallel_unsequenced_policy>)
+    ->Apply(sorting_records_arguments)
+    ->UseRealTime();
+BENCHMARK(sorting_records<32, std::execution::parallel_unsequenced_policy>)
+    ->Apply(sorting_records_arguments)
+    ->UseRealTime();
+BENCHMARK(sorting_records<64, std::execution::parallel_unsequenced_policy>)
+    ->Apply(sorting_records_arguments)
+    ->UseRealTime();
+BENCHMARK(sorting_records<128, std::execution::parallel_unsequenced_policy>)
+    ->Apply(sorting_records_arguments)
+    ->UseRealTime();
+
+#endif
+
+// ------------------------------------
+// ## Top-K Selection
+// ------------------------------------
+//
+// We need the `k` smallest keys far more often than a fully sorted column: for `ORDER BY ... LIMIT k`,
+// nearest-neighbor search, or leaderboards. Sorting everything costs O(N log N), while selection
+// can be done in O(N), and for small `k` the constant factor is all about how cheaply we skip
+// the keys that obviously won't make it.
+//
+// All the variants below produce the same output: the `k` smallest keys, sorted in ascending order,
+// without modifying the input column.
+
+/// `std::partial_sort_copy` keeps a heap of the `k` best keys directly in the output.
+struct top_k_partial_sort_t {
+    template <typename execution_policy_at>
+    void operator()(execution_policy_at &&policy, std::int32_t const *data, std::size_t count, std::int32_t *top,
+                    std::size_t k) const {
+        std::partial_sort_copy(policy, data, data + count, top, top + k);
+    }
+};
+
+/// `std::nth_element` is an Intro-Select, but it reorders its input, so it works on a copy.
+struct top_k_nth_element_t {
+    std::vector<std::int32_t> scratch;
+
+    template <typename execution_policy_at>
+    void operator()(execution_policy_at &&policy, std::int32_t const *data, std::size_t count, std::int32_t *top,
+                    std::size_t k) {
+        scratch.resize(count);
+        std::copy(policy, data, data + count, scratch.begin());
+        std::nth_element(policy, scratch.begin(), scratch.begin() + (k - 1), scratch.end());
+        std::sort(policy, scratch.begin(), scratch.begin() + k);
+        std::copy(scratch.begin(), scratch.begin() + k, top);
+    }
+};
+
+/// @brief  Keeps the `k` smallest keys seen so far in a max-heap, bounded to `k` entries.
+///         Most keys are rejected with a single comparison against the heap's root.
+///         Reversed inputs are its worst case, as every key replaces the root.
+inline void top_k_heap(std::int32_t const *data, std::size_t count, std::int32_t *top, std::size_t k) noexcept {
+    std::copy(data, data + k, top);
+    std::make_heap(top, top + k);
+    for (std::size_t i = k; i != count; ++i) {
+        std::int32_t const key = data[i];
+        if (key >= top[0])
+            continue;
+        // Replace the root and sift it down, which is cheaper than a `std::pop_heap` + `std::push_heap` pair.
+        std::size_t parent = 0;
+        for (std::size_t child = 1; child < k; parent = child, child = 2 * child + 1) {
+            if (child + 1 < k && top[child] < top[child + 1])
+                ++child;
+            if (top[child] <= key)
+                break;
+            top[parent] = top[child];
+        }
+        top[parent] = key;
+    }
+    std::sort_heap(top, top + k);
+}
+
+struct top_k_heap_t {
+    template <typename execution_policy_at>
+    void operator()(execution_policy_at &&, std::int32_t const *data, std::size_t count, std::int32_t *top,
+                    std::size_t k) const noexcept {
+        top_k_heap(data, count, top, k);
+    }
+};
+
+/// @brief  Copies the keys smaller than `threshold` into `out`, that must have room for `count + lanes` keys.
+///         Reuses the partition kernels of the vectorized Quick-Sort, discarding the right side.
+template <typename lanes_at>
+std::size_t filter_vectorized(std::int32_t const *data, std::size_t count, std::int32_t threshold,
+                              std::int32_t *out) noexcept {
+    constexpr std::size_t width = lanes_at::count_k;
+    auto const thresholds = lanes_at::broadcast(threshold);
+    std::int32_t discarded[width];
+    std::size_t written = 0, i = 0;
+    for (; i + width <= count; i += width)
+        written += lanes_at::partition(lanes_at::load(data + i), thresholds, out + written, discarded + width);
+    for (; i != count; ++i)
+        out[written] = data[i], written += data[i] < threshold;
+    return written;
+}
+
+/// @brief  Estimates a threshold from a small sample, filters the candidates below it with SIMD,
+///         and only selects among the survivors. If the estimate is too tight, falls back to `nth_element`.
+struct top_k_filter_t {
+    static constexpr std::size_t sample_k = 4096;
+    std::vector<std::int32_t> sample, candidates;
+    top_k_nth_element_t fallback;
+
+    template <typename execution_policy_at>
+    void operator()(execution_policy_at &&policy, std::int32_t const *data, std::size_t count, std::int32_t *top,
+                    std::size_t k) {
+        if (count < sample_k * 4 || k * 8 > count)
+            return fallback(policy, data, count, top, k);
+
+        // An evenly strided sample is representative of sorted and reversed inputs as well as random ones.
+        // Aiming at twice the expected rank makes it unlikely, that fewer than `k` keys pass the filter.
+        sample.resize(sample_k);
+        for (std::size_t i = 0; i != sample_k; ++i)
+            sample[i] = data[i * count / sample_k];
+        std::size_t const rank = std::min(sample_k - 1, k * sample_k / count * 2 + 16);
+        std::nth_element(sample.begin(), sample.begin() + rank, sample.end());
+        std::int32_t const threshold = sample[rank];
+
+        candidates.resize(count + 64);
+#if defined(__AVX512F__)
+        std::size_t const passed =
+            filter_vectorized<partition_avx512_gt<std::int32_t>>(data, count, threshold, candidates.data());
+#elif defined(__AVX2__)
+        std::size_t const passed =
+            filter_vectorized<partition_avx2_gt<std::int32_t>>(data, count, threshold, candidates.data());
+#else
+        std::size_t passed = 0;
+        for (std::size_t i = 0; i != count; ++i)
+            candidates[passed] = data[i], passed += data[i] < threshold;
+#endif
+        if (passed < k)
+            return fallback(policy, data, count, top, k);
+        std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.begin() + passed);
+        std::sort(candidates.begin(), candidates.begin() + k);
+        std::copy(candidates.begin(), candidates.begin() + k, top);
+    }
+};
+
+/// @brief  Every thread finds the top-k of its own slice with a bounded heap, and the
+///         `threads * k` partial results are merged with a final selection.
+struct top_k_per_thread_t {
+    std::vector<std::int32_t> partial;
+
+    template <typename execution_policy_at>
+    void operator()(execution_policy_at &&policy, std::int32_t const *data, std::size_t count, std::int32_t *top,
+                    std::size_t k) {
+        // Oversubscribe a little, so that threads finishing early can pick up more slices.
+        std::size_t const threads = std::max(std::thread::hardware_concurrency(), 1u);
+        std::size_t const slices = std::max<std::size_t>(1, std::min(threads * 4, count / (k * 4)));
+        std::vector<std::size_t> slice_ids(slices);
+        std::iota(slice_ids.begin(), slice_ids.end(), std::size_t(0));
+        partial.resize(slices * k);
+        std::for_each(policy, slice_ids.begin(), slice_ids.end(), [&](std::size_t slice) {
+            std::size_t const first = count * slice / slices, last = count * (slice + 1) / slices;
+            top_k_heap(data + first, last - first, partial.data() + slice * k, k);
+        });
+        std::nth_element(partial.begin(), partial.begin() + (k - 1), partial.end());
+        std::sort(partial.begin(), partial.begin() + k);
+        std::copy(partial.begin(), partial.begin() + k, top);
+    }
+};
+
+template <typename execution_policy_t, typename top_k_at>
+static void top_k(bm::State &state, execution_policy_t &&policy, top_k_at algorithm) {
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto k = static_cast<std::size_t>(state.range(1));
+    auto distribution = static_cast<distribution_t>(state.range(2));
+    std::vector<std::int32_t> data(count), top(k);
+    generate_distribution(policy, data.data(), count, distribution);
+    state.SetLabel(distribution_name(distribution));
+
+    for (auto _ : state) {
+        algorithm(policy, data.data(), count, top.data(), k);
+        bm::DoNotOptimize(top.data());
+    }
+
+    // The output must be exactly the `k` smallest keys in ascending order, duplicates included.
+    std::vector<std::int32_t> expected(k);
+    std::partial_sort_copy(data.begin(), data.end(), expected.begin(), expected.end());
+    if (top != expected)
+        return state.SkipWithError("The result differs from `std::partial_sort_copy`");
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(count * state.iterations() * sizeof(std::int32_t));
+}
+
+/// Sweeps `N` and `k` on the uniform inputs, and the reversed ones, that `super_sort` uses.
+static void top_k_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgsProduct(
+        {{1l << 20, 1l << 24}, {1, 16, 256, 4096, 65536}, {distribution_uniform_k, distribution_reversed_k}});
+    benchmark->ArgNames({"count", "k", "distribution"});
+}
+
+#ifdef __cpp_lib_parallel_algorithm
+
+// On reversed inputs every key enters the heap, and the heap-based variants become ~15x slower,
+// while the sampled threshold of the SIMD filter doesn't care about the order of the keys.
+BENCHMARK_CAPTURE(top_k, partial_sort_seq, std::execution::seq, top_k_partial_sort_t{})->Apply(top_k_arguments);
+BENCHMARK_CAPTURE(top_k, nth_element_seq, std::execution::seq, top_k_nth_element_t{})->Apply(top_k_arguments);
+BENCHMARK_CAPTURE(top_k, heap_seq, std::execution::seq, top_k_heap_t{})->Apply(top_k_arguments);
+BENCHMARK_CAPTURE(top_k, filter_seq, std::execution::seq, top_k_filter_t{})->Apply(top_k_arguments);
+BENCHMARK_CAPTURE(top_k, per_thread_seq, std::execution::seq, top_k_per_thread_t{})->Apply(top_k_arguments);
+
+// The bounded heap and the SIMD filter are single-threaded by design, and the per-thread variant
+// parallelizes the heap. The standard algorithms accept the policy directly.
+BENCHMARK_CAPTURE(top_k, partial_sort_par_unseq, std::execution::par_unseq, top_k_partial_sort_t{})
+    ->Apply(top_k_arguments)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(top_k, nth_element_par_unseq, std::execution::par_unseq, top_k_nth_element_t{})
+    ->Apply(top_k_arguments)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(top_k, per_thread_par_unseq, std::execution::par_unseq, top_k_per_thread_t{})
+    ->Apply(top_k_arguments)
+    ->UseRealTime();
+
+#endif
+
+// ------------------------------------
+// ## Beyond comparisons: Parallel Radix Sort
+// ------------------------------------
+//
+// The `perf stat` output in the README shows `super_sort` retiring just 0.18 instructions per cycle
+// with 36 cores busy. Comparison sorts perform O(N log N) data-dependent branches and random accesses,
+// so most of those cores are just waiting for memory. Radix sort replaces comparisons with counting:
+// each pass reads the input once to build a histogram of one "digit", and once more to scatter it.
+//
+// We go from the Most Significant Digit (MSD) down. After the first scatter, every bucket is independent
+// and can be sorted by a separate task, so the parallelism only grows with recursion depth.
+
+#if defined(TUTORIAL_USE_TBB)
+
+/// @brief  Parallel MSD radix sort for 32-bit signed integers, built on TBB tasks.
+///
+/// Every pass is split into three stages:
+/// 1. Each block of the input builds its own 256-bin histogram of the current byte.
+/// 2. A prefix sum over (bucket, block) pairs tells every block where its keys will land.
+/// 3. Each block scatters its keys into the second buffer through small "write-combining" buffers.
+///
+/// Scattering single 4-byte keys into 256 different destinations touches 256 cache lines at once.
+/// Accumulating 64 bytes per bucket in L1 first and flushing whole cache lines makes the writes
+/// sequential from the memory controller's point of view.
+class radix_sort_t {
+  public:
+    static constexpr std::size_t bits_per_pass_k = 8;
+    static constexpr std::size_t buckets_k = 1 << bits_per_pass_k;
+    static constexpr std::size_t cache_line_keys_k = 64 / sizeof(std::int32_t);
+    static constexpr std::size_t comparison_threshold_k = 1024;  ///< Finish tiny buckets with `std::sort`
+    static constexpr std::size_t parallel_threshold_k = 1 << 16; ///< Don't spawn tasks for small buckets
+
+    explicit radix_sort_t(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) noexcept
+        : resource_(resource) {}
+
+    void operator()(std::int32_t *begin, std::int32_t *end) {
+        std::size_t const count = static_cast<std::size_t>(end - begin);
+        // We don't want to zero-initialize gigabytes of memory, just to overwrite it.
+        // Leaving the pages untouched also lets the first parallel scatter place them closer to the
+        // NUMA node that will use them.
+        scratch_buffer_gt<std::int32_t> buffer(count, resource_);
+        sort_(begin, buffer.data(), count, 32 - bits_per_pass_k, false, resource_);
+    }
+
+  private:
+    using histogram_t = std::array<std::size_t, buckets_k>;
+
+    std::pmr::memory_resource *resource_;
+
+    /// Flipping the sign bit maps signed integers onto unsigned ones, preserving their order.
+    static std::size_t digit_(std::int32_t key, std::size_t shift) noexcept {
+        return ((static_cast<std::uint32_t>(key) ^ 0x80000000u) >> shift) & (buckets_k - 1);
+    }
+
+    template <typename callable_at>
+    static void for_each_index_(bool parallel, std::size_t count, callable_at &&callable) {
+        if (parallel)
+            tbb::parallel_for(std::size_t(0), count, callable);
+        else
+            for (std::size_t i = 0; i != count; ++i)
+                callable(i);
+    }
+
+    static void copy_(bool parallel, std::int32_t const *from, std::int32_t *to, std::size_t count) {
+        std::size_t const blocks = parallel ? divide_round_up_(count, parallel_threshold_k) : 1;
+        for_each_index_(parallel, blocks, [=](std::size_t block) {
+            std::size_t const first = block * parallel_threshold_k;
+            std::size_t const last = parallel ? std::min(first + parallel_threshold_k, count) : count;
+            std::copy(from + first, from + last, to + first);
+        });
+    }
+
+    static std::size_t divide_round_up_(std::size_t a, std::size_t b) noexcept { return (a + b - 1) / b; }
+
+    /// @brief  Sorts `count` keys starting at `from`, using `to` as the second buffer.
+    /// @param  result_in_to  Whether the sorted keys must end up in `to` rather than `from`.
+    static void sort_(std::int32_t *from, std::int32_t *to, std::size_t count, std::size_t shift, bool result_in_to,
+                      std::pmr::memory_resource *resource) {
+
+        bool const parallel = count >= parallel_threshold_k;
+        if (count <= comparison_threshold_k) {
+            std::sort(from, from + count);
+            if (result_in_to)
+                std::copy(from, from + count, to);
+            return;
+        }
+
+        // Pick the number of blocks to keep all cores busy, without making the histograms too large.
+        std::size_t const max_blocks = static_cast<std::size_t>(tbb::this_task_arena::max_concurrency()) * 4;
+        std::size_t const blocks = parallel ? std::min(max_blocks, count / parallel_threshold_k) : 1;
+        std::size_t const block_size = divide_round_up_(count, blocks);
+        std::pmr::vector<histogram_t> histograms(blocks, resource);
+        for_each_index_(parallel, blocks, [&](std::size_t block) {
+            histogram_t &histogram = histograms[block];
+            histogram.fill(0);
+            std::size_t const first = block * block_size, last = std::min(first + block_size, count);
+            for (std::size_t i = first; i < last; ++i)
+                ++histogram[digit_(from[i], shift)];
+        });
+
+        // Convert the counts into exclusive prefix sums, bucket-major, so that every block
+        // gets its own contiguous slice inside every bucket.
+        histogram_t bucket_starts, bucket_sizes;
+        std::size_t running_offset = 0;
+        for (std::size_t bucket = 0; bucket != buckets_k; ++bucket) {
+            bucket_starts[bucket] = running_offset;
+            for (std::size_t block = 0; block != blocks; ++block) {
+                std::size_t const block_count = histograms[block][bucket];
+                histograms[block][bucket] = running_offset;
+                running_offset += block_count;
+            }
+            bucket_sizes[bucket] = running_offset - bucket_starts[bucket];
+        }
+
+        // If all the keys share the same digit, like the top byte of small positive integers,
+        // the scatter would be a plain copy. Skip straight to the next digit.
+        bool const single_bucket = std::find(bucket_sizes.begin(), bucket_sizes.end(), count) != bucket_sizes.end();
+        if (single_bucket) {
+            if (shift != 0)
+                return sort_(from, to, count, shift - bits_per_pass_k, result_in_to, resource);
+            if (result_in_to)
+                copy_(parallel, from, to, count);
+            return;
+        }
+
+        for_each_index_(parallel, blocks, [&](std::size_t block) {
+            histogram_t &offsets = histograms[block];
+            alignas(64) std::int32_t combining_buffers[buckets_k][cache_line_keys_k];
+            std::uint8_t combining_lengths[buckets_k] = {0};
+            std::size_t const first = block * block_size, last = std::min(first + block_size, count);
+            for (std::size_t i = first; i < last; ++i) {
+                std::int32_t const key = from[i];
+                std::size_t const bucket = digit_(key, shift);
+                combining_buffers[bucket][combining_lengths[bucket]++] = key;
+                if (combining_lengths[bucket] != cache_line_keys_k)
+                    continue;
+                std::memcpy(to + offsets[bucket], combining_buffers[bucket], sizeof(combining_buffers[bucket]));
+                offsets[bucket] += cache_line_keys_k;
+                combining_lengths[bucket] = 0;
+            }
+            for (std::size_t bucket = 0; bucket != buckets_k; ++bucket)
+                std::memcpy(to + offsets[bucket], combining_buffers[bucket],
+                            combining_lengths[bucket] * sizeof(std::int32_t));
+        });
+
+        // The keys now live in `to`, so the roles of the buffers swap for the next digit.
+        if (shift == 0) {
+            if (!result_in_to)
+                copy_(parallel, to, from, count);
+            return;
+        }
+        for_each_index_(parallel, buckets_k, [&](std::size_t bucket) {
+            std::size_t const start = bucket_starts[bucket];
+            sort_(to + start, from + start, bucket_sizes[bucket], shift - bits_per_pass_k, !result_in_to, resource);
+        });
+    }
+};
+
+template <typename execution_policy_t> static void super_sort_radix(bm::State &state, execution_policy_t &&policy) {
+
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto distribution = static_cast<distribution_t>(state.range(1));
+    if (!fits_in_memory(2 * count * sizeof(std::int32_t)))
+        return state.SkipWithError("Not enough memory for the keys and the scratch buffer");
+    std::vector<std::int32_t> array(count);
+    state.SetLabel(distribution_name(distribution));
+    // The arena keeps the second buffer and the histograms between iterations.
+    arena_resource_t arena;
+    radix_sort_t sorter(&arena);
+
+    double sort_seconds = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        generate_distribution(policy, array.data(), count, distribution);
+        state.ResumeTiming();
+        auto start = std::chrono::steady_clock::now();
+        sorter(array.data(), array.data() + count);
+        sort_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        arena.reset();
+        bm::DoNotOptimize(array.size());
+    }
+    if (!std::is_sorted(policy, array.begin(), array.end()))
+        return state.SkipWithError("The keys are not sorted");
+
+    state.SetComplexityN(count);
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(count * state.iterations() * sizeof(std::int32_t));
+
+    // The generator is deterministic, so the reference run will see exactly the same input.
+    std::string const reference_name = std::string("super_sort/par_unseq/") + distribution_name(distribution);
+    double const par_unseq_seconds = prepared_reference_seconds(
+        reference_name, count, [&] { generate_distribution(policy, array.data(), count, distribution); },
+        [&] { std::sort(policy, array.begin(), array.end()); });
+    state.counters["speedup_vs_par_unseq"] = par_unseq_seconds / (sort_seconds / state.iterations());
+}
+
+#ifdef __cpp_lib_parallel_algorithm
+
+// Same 1M to 4B sweep, as the `std::sort` variants above, with the wall-clock time
+// to account for all the threads. The radix sort needs a second buffer as large as the input,
+// so the largest sizes are skipped on machines with less than 64 GB of RAM. Also note, that
+// the 32-bit keys wrap around above 2^31, so the "reversed" 4B input is really two descending runs.
+BENCHMARK_CAPTURE(super_sort_radix, par_unseq, std::execution::par_unseq)
+    ->ArgsProduct({bm::CreateRange(1l << 20, 1l << 32, 8), {distribution_reversed_k}})
+    ->MinTime(10)
+    ->Complexity(bm::oN)
+    ->UseRealTime();
+
+// Radix sort doesn't care about the order of the keys, only about their bytes. Few unique keys
+// or an all-equal column collapse into a single bucket per pass, which we detect and skip.
+BENCHMARK_CAPTURE(super_sort_radix, par_unseq, std::execution::par_unseq)
+    ->ArgsProduct({{1l << 24}, all_distributions()})
+    ->MinTime(10)
+    ->UseRealTime();
+
+#endif
+// ------------------------------------
+// ## Parallel Stable Merge Sort
+// ------------------------------------
+//
+// `std::sort` isn't stable, and our pipelines often need records with equal keys to keep their order.
+// `std::stable_sort` is a merge sort, and a naive parallel merge sort splits the input, sorts the halves
+// in parallel, and merges them... on a single core. That last merge touches every element,
+// so by Amdahl's law it caps the speedup at ~log2(N) no matter how many cores we have.
+//
+// The "merge path" trick removes that bottleneck. To find where the k-th output of a merge comes from,
+// a binary search along the anti-diagonal of the (A, B) grid finds the split `i + j = k`, such that
+// `A[0, i)` and `B[0, j)` are exactly the first `k` outputs. Every thread can then merge its own
+// slice of the output, independently from the others.
+// https://web.cs.ucdavis.edu/~amenta/f15/GPUmp.pdf
+
+/// @brief  Parallel stable merge sort, running on the TBB work-stealing scheduler.
+///
+/// 1. The input is cut into one run per thread, and every run is sorted with `std::stable_sort`.
+/// 2. Neighboring runs are merged pairwise, ping-ponging between the input and a second buffer.
+///    Every merge is cut into pieces of `merge_grain_k` outputs, so even the final merge of two halves
+///    is spread across all the threads.
+template <typename element_at, typename less_at = std::less<element_at>> class merge_sort_gt {
+  public:
+    static constexpr std::size_t merge_grain_k = 1 << 16;          ///< Outputs produced by a single merge task
+    static constexpr std::size_t sequential_threshold_k = 1 << 14; ///< Smallest run worth a separate thread
+
+    explicit merge_sort_gt(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) noexcept
+        : resource_(resource) {}
+
+    void operator()(element_at *begin, element_at *end, less_at less = {}) {
+        std::size_t const count = static_cast<std::size_t>(end - begin);
+        std::size_t const threads = static_cast<std::size_t>(tbb::this_task_arena::max_concurrency());
+        std::size_t const runs = std::max<std::size_t>(1, std::min(threads, count / sequential_threshold_k));
+        if (runs == 1)
+            return std::stable_sort(begin, end, less);
+        scratch_buffer_gt<element_at> buffer(count, resource_);
+
+        std::pmr::vector<std::size_t> bounds(runs + 1, resource_);
+        for (std::size_t run = 0; run <= runs; ++run)
+            bounds[run] = count * run / runs;
+        tbb::parallel_for(std::size_t(0), runs, [&](std::size_t run) {
+            std::stable_sort(begin + bounds[run], begin + bounds[run + 1], less);
+        });
+
+        element_at *from = begin, *to = buffer.data();
+        while (bounds.size() > 2) {
+            merge_pairs_(from, to, bounds, less, resource_);
+            std::pmr::vector<std::size_t> merged_bounds(resource_);
+            for (std::size_t run = 0; run + 1 < bounds.size(); run += 2)
+                merged_bounds.push_back(bounds[run]);
+            merged_bounds.push_back(count);
+            bounds.swap(merged_bounds);
+            std::swap(from, to);
+        }
+
+        if (from != begin)
+            tbb::parallel_for(std::size_t(0), divide_round_up_(count, merge_grain_k), [=](std::size_t block) {
+                std::size_t const first = block * merge_grain_k;
+                std::copy(from + first, from + std::min(first + merge_grain_k, count), begin + first);
+            });
+    }
+
+  private:
+    std::pmr::memory_resource *resource_;
+
+    struct piece_t {
+        std::size_t first_run;    ///< Index of the left run in the pair being merged
+        std::size_t output_first; ///< First output position, relative to the whole array
+        std::size_t output_last;  ///< Past-the-end output position, relative to the whole array
+    };
+
+    static std::size_t divide_round_up_(std::size_t a, std::size_t b) noexcept { return (a + b - 1) / b; }
+
+    /// @brief  Returns how many of the first `k` outputs of the stable merge of `a` and `b` come from `a`.
+    ///         On ties, keys from `a` go first, to preserve stability.
+    static std::size_t co_rank_(std::size_t k, element_at const *a, std::size_t a_count, element_at const *b,
+                                std::size_t b_count, less_at const &less) noexcept {
+        std::size_t low = k > b_count ? k - b_count : 0, high = std::min(k, a_count);
+        while (low < high) {
+            std::size_t const i = low + (high - low) / 2, j = k - i;
+            // If `a[i]` must precede `b[j - 1]`, then `a[i]` belongs to the first `k` outputs as well.
+            if (j > 0 && !less(b[j - 1], a[i]))
+                low = i + 1;
+            else
+                high = i;
+        }
+        return low;
+    }
+
+    static void merge_pairs_(element_at const *from, element_at *to, std::pmr::vector<std::size_t> const &bounds,
+                             less_at const &less, std::pmr::memory_resource *resource) {
+        // The pieces of all the merges on this level go into a single parallel loop,
+        // so that threads finishing a small merge can steal pieces of a larger one.
+        std::size_t const runs = bounds.size() - 1;
+        std::pmr::vector<piece_t> pieces(resource);
+        for (std::size_t run = 0; run < runs; run += 2) {
+            std::size_t const last = bounds[std::min(run + 2, runs)];
+            for (std::size_t output = bounds[run]; output < last; output += merge_grain_k)
+                pieces.push_back({run, output, std::min(output + merge_grain_k, last)});
+        }
+
+        tbb::parallel_for(std::size_t(0), pieces.size(), [&](std::size_t index) {
+            piece_t const &piece = pieces[index];
+            // The last run on an odd level has no pair, and is just copied, as a merge with an empty run.
+            std::size_t const a_first = bounds[piece.first_run], a_last = bounds[piece.first_run + 1];
+            std::size_t const b_last = bounds[std::min(piece.first_run + 2, runs)];
+            element_at const *a = from + a_first, *b = from + a_last;
+            std::size_t const a_count = a_last - a_first, b_count = b_last - a_last;
+            std::size_t const k_first = piece.output_first - a_first, k_last = piece.output_last - a_first;
+            std::size_t const i_first = co_rank_(k_first, a, a_count, b, b_count, less);
+            std::size_t const i_last = co_rank_(k_last, a, a_count, b, b_count, less);
+            std::merge(a + i_first, a + i_last, b + (k_first - i_first), b + (k_last - i_last), to + piece.output_first,
+                       less);
+        });
+    }
+};
+
+/// A key with its original position, to check if the equal keys kept their order.
+struct positioned_key_t {
+    std::int32_t key;
+    std::uint32_t position;
+};
+
+struct positioned_key_less_t {
+    bool operator()(positioned_key_t const &a, positioned_key_t const &b) const noexcept { return a.key < b.key; }
+};
+
+/// Sorts keys with just 16 distinct values, and checks that the equal ones kept their input order.
+inline bool merge_sort_is_stable(std::size_t count) {
+    std::vector<std::int32_t> keys(count);
+    generate_distribution(keys.data(), count, distribution_few_unique_k);
+    std::vector<positioned_key_t> records(count);
+    for (std::size_t i = 0; i != count; ++i)
+        records[i] = {keys[i], static_cast<std::uint32_t>(i)};
+
+    merge_sort_gt<positioned_key_t, positioned_key_less_t> sorter;
+    sorter(records.data(), records.data() + count);
+    auto reordered = [](positioned_key_t const &a, positioned_key_t const &b) {
+        return a.key > b.key || (a.key == b.key && a.position > b.position);
+    };
+    return std::adjacent_find(records.begin(), records.end(), reordered) == records.end();
+}
+
+template <typename execution_policy_t> static void super_sort_merge(bm::State &state, execution_policy_t &&policy) {
+
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto distribution = static_cast<distribution_t>(state.range(1));
+    if (!fits_in_memory(2 * count * sizeof(std::int32_t)))
+        return state.SkipWithError("Not enough memory for the keys and the merge buffer");
+    std::vector<std::int32_t> array(count);
+    state.SetLabel(distribution_name(distribution));
+    arena_resource_t scratch;
+    merge_sort_gt<std::int32_t> sorter(&scratch);
+
+    // The sequential policy confines the sort to a single-threaded arena.
+    bool const sequential = std::is_same<std::decay_t<execution_policy_t>, std::execution::sequenced_policy>::value;
+    tbb::task_arena arena(sequential ? 1 : tbb::task_arena::automatic);
+
+    // Only the sort itself is timed for the efficiency counter, excluding the input generation.
+    double sort_seconds = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        generate_distribution(policy, array.data(), count, distribution);
+        state.ResumeTiming();
+        auto start = std::chrono::steady_clock::now();
+        arena.execute([&] { sorter(array.data(), array.data() + count); });
+        sort_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        scratch.reset();
+        bm::DoNotOptimize(array.size());
+    }
+    if (!std::is_sorted(policy, array.begin(), array.end()))
+        return state.SkipWithError("The keys are not sorted");
+
+    state.SetComplexityN(count);
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(count * state.iterations() * sizeof(std::int32_t));
+
+    // Scaling efficiency is the speedup over a single thread, divided by the number of threads.
+    // 100% means perfect scaling, and memory-bound merges usually land far below that.
+    std::size_t const threads = static_cast<std::size_t>(arena.max_concurrency());
+    std::string const reference_name = std::string("super_sort_merge/1_thread/") + distribution_name(distribution);
+    tbb::task_arena single_thread(1);
+    double const single_thread_seconds = prepared_reference_seconds(
+        reference_name, count,
+        [&] {
+            scratch.reset();
+            generate_distribution(policy, array.data(), count, distribution);
+        },
+        [&] { single_thread.execute([&] { sorter(array.data(), array.data() + count); }); });
+    double const speedup = single_thread_seconds / (sort_seconds / state.iterations());
+    state.counters["threads"] = static_cast<double>(threads);
+    state.counters["scaling_efficiency"] = speedup / threads;
+    state.counters["stable"] = merge_sort_is_stable(std::min<std::size_t>(count, 1 << 24));
+}
+
+#ifdef __cpp_lib_parallel_algorithm
+
+// Like the radix sort, the merge sort borrows a buffer as large as the input, so it skips the sizes
+// that don't fit, and its 4B "reversed" input also wraps around into two descending runs.
+BENCHMARK_CAPTURE(super_sort_merge, seq, std::execution::seq)
+    ->ArgsProduct({bm::CreateRange(1l << 20, 1l << 32, 8), {distribution_reversed_k}})
+    ->MinTime(10)
+    ->Complexity(bm::oNLogN);
+
+BENCHMARK_CAPTURE(super_sort_merge, par_unseq, std::execution::par_unseq)
+    ->ArgsProduct({bm::CreateRange(1l << 20, 1l << 32, 8), {distribution_reversed_k}})
+    ->MinTime(10)
+    ->Complexity(bm::oNLogN)
+    ->UseRealTime();
+
+BENCHMARK_CAPTURE(super_sort_merge, par_unseq, std::execution::par_unseq)
+    ->ArgsProduct({{1l << 24}, all_distributions()})
+    ->MinTime(10)
+    ->UseRealTime();
+
+#endif
+
+// Now let's measure what the arena saves. The same sorters run either straight on the heap, or on an arena
+// that is reset after every sort. Both variants count the allocations that actually reached the heap.
+// Those exclude the internal buffers of `std::stable_sort` and the TBB task allocations, that bypass `pmr`.
+template <typename sorter_at> static void sorting_with_arena(bm::State &state) {
+
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto distribution = static_cast<distribution_t>(state.range(1));
+    bool const use_arena = state.range(2) != 0;
+    std::vector<std::int32_t> array(count);
+    state.SetLabel(distribution_name(distribution));
+
+    counting_resource_t heap;
+    arena_resource_t arena(&heap);
+    sorter_at sorter(use_arena ? static_cast<std::pmr::memory_resource *>(&arena) : &heap);
+    for (auto _ : state) {
+        state.PauseTiming();
+        generate_distribution(array.data(), count, distribution);
+        state.ResumeTiming();
+        sorter(array.data(), array.data() + count);
+        arena.reset();
+        bm::DoNotOptimize(array.data());
+    }
+    if (!std::is_sorted(array.begin(), array.end()))
+        return state.SkipWithError("The keys are not sorted");
+
+    state.SetItemsProcessed(count * state.iterations());
+    state.counters["heap_allocations"] =
+        bm::Counter(static_cast<double>(heap.allocations()), bm::Counter::kAvgIterations);
+    state.counters["heap_bytes"] =
+        bm::Counter(static_cast<double>(heap.bytes()), bm::Counter::kAvgIterations, bm::Counter::OneK::kIs1024);
+}
+
+static void sorting_with_arena_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark
+        ->ArgsProduct({{1 << 12, 1 << 16, 1 << 20}, {distribution_uniform_k, distribution_sawtooth_k}, {false, true}})
+        ->ArgNames({"count", "distribution", "arena"});
+}
+
+// Allocators like glibc's keep small blocks in free lists, so most of the savings come from the large buffers.
+// Those above the `mmap` threshold of 128 KB go back to the OS on every `free`, and every first touch of
+// their pages is a page fault again. On a single-core VM that costs ~3% of a 1M-key radix sort,
+// and grows with the number of threads faulting in parallel.
+BENCHMARK_TEMPLATE(sorting_with_arena, radix_sort_t)->Apply(sorting_with_arena_arguments);
+BENCHMARK_TEMPLATE(sorting_with_arena, merge_sort_gt<std::int32_t>)->Apply(sorting_with_arena_arguments);
+#ifdef __cpp_lib_parallel_algorithm
+BENCHMARK_TEMPLATE(sorting_with_arena, adaptive_sort_gt<std::int32_t>)->Apply(sorting_with_arena_arguments);
+#endif
+
+#endif // defined(TUTORIAL_USE_TBB)
+
+// ------------------------------------
+// ## Out-of-Core Sorting
+// ------------------------------------
+//
+// The 4 billion keys of `super_sort` take 16 GB, and simply fail to allocate on smaller machines.
+// Datasets larger than RAM are sorted in two phases:
+// 1. Cut the input into "runs" that fit into a memory budget, sort each of them, and spill them to disk.
+// 2. Merge all the sorted runs at once, streaming them from disk, with a k-way merge.
+//
+// Memory-mapping the files lets the kernel do all the buffering. We only tell it what we'll need next,
+// with `madvise`, and what we won't need anymore, so our footprint stays within the budget.
+#if defined(__unix__) || defined(__APPLE__)
+
+/// @brief  Memory-mapped temporary file, that is deleted as soon as it's created.
+///         The file lives until it's unmapped, and never outlives the process, even if it crashes.
+///
+/// A file sized with `ftruncate` alone is sparse: its blocks are only allocated on the first write.
+/// If the disk or the `tmpfs` runs out by then, the write through the mapping raises a `SIGBUS`, that kills
+/// the whole process. So every block is reserved upfront, and the file stays null if that fails.
+class mapped_file_t {
+  public:
+    explicit mapped_file_t(std::size_t bytes) noexcept {
+        std::string path = directory() + "/tutorial_XXXXXX";
+        int descriptor = ::mkstemp(&path[0]);
+        if (descriptor < 0)
+            return;
+        ::unlink(path.c_str());
+#if defined(__APPLE__)
+        fstore_t store = {F_ALLOCATEALL, F_PEOFPOSMODE, 0, static_cast<off_t>(bytes), 0};
+        bool const reserved =
+            ::fcntl(descriptor, F_PREALLOCATE, &store) != -1 && ::ftruncate(descriptor, static_cast<off_t>(bytes)) == 0;
+#else
+        bool const reserved = ::posix_fallocate(descriptor, 0, static_cast<off_t>(bytes)) == 0;
+#endif
+        void *address = MAP_FAILED;
+        if (reserved)
+            address = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        ::close(descriptor);
+        if (address != MAP_FAILED)
+            data_ = static_cast<std::byte *>(address), size_ = bytes;
+    }
+    ~mapped_file_t() noexcept {
+        if (data_)
+            ::munmap(data_, size_);
+    }
+    mapped_file_t(mapped_file_t const &) = delete;
+    mapped_file_t &operator=(mapped_file_t const &) = delete;
+
+    explicit operator bool() const noexcept { return data_ != nullptr; }
+    template <typename element_at> element_at *as() const noexcept { return reinterpret_cast<element_at *>(data_); }
+
+    /// @brief  The directory for the temporary files: `TMPDIR`, or `/tmp` by default.
+    static std::string directory() {
+        char const *directory = std::getenv("TMPDIR");
+        return directory ? directory : "/tmp";
+    }
+
+    /// @brief  Bytes available to unprivileged users in the `directory()`, or zero if unknown.
+    static std::size_t free_space() noexcept {
+        struct statvfs stats;
+        if (::statvfs(directory().c_str(), &stats) != 0)
+            return 0;
+        return static_cast<std::size_t>(stats.f_bavail) * static_cast<std::size_t>(stats.f_frsize);
+    }
+
+    /// @brief  Hints the kernel about the future use of a byte range, widened to whole pages.
+    /// @param  advice  `MADV_SEQUENTIAL`, `MADV_WILLNEED`, `MADV_DONTNEED`, etc.
+    void advise(std::size_t offset, std::size_t length, int advice) const noexcept {
+        static std::size_t const page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::size_t const first = offset / page_size * page_size;
+        std::size_t const last = std::min(offset + length, size_);
+        if (first < last)
+            ::madvise(data_ + first, last - first, advice);
+    }
+
+  private:
+    std::byte *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+/// @brief  Tournament tree for k-way merging, where every internal node keeps the loser of its match.
+///         When the winner is replaced by the next key from its run, only the matches on its path to
+///         the root are replayed. That's `log2(k)` comparisons against a single sibling each, while a
+///         binary heap compares both children on every level.
+class loser_tree_t {
+  public:
+    /// @param  beats  Callable, that checks if the leaf `a` must be merged before the leaf `b`.
+    template <typename beats_at> void build(std::size_t leaves, beats_at &&beats) {
+        leaves_ = leaves;
+        nodes_.assign(leaves, 0);
+        std::vector<std::size_t> winners(2 * leaves);
+        std::iota(winners.begin() + leaves, winners.end(), std::size_t(0));
+        for (std::size_t node = leaves - 1; node != 0; --node) {
+            std::size_t const left = winners[2 * node], right = winners[2 * node + 1];
+            bool const left_wins = beats(left, right);
+            winners[node] = left_wins ? left : right;
+            nodes_[node] = left_wins ? right : left;
+        }
+        nodes_[0] = winners[1];
+    }
+
+    std::size_t winner() const noexcept { return nodes_[0]; }
+
+    /// @brief  Finds the new winner, after the current one has changed its key.
+    template <typename beats_at> void replay(beats_at &&beats) noexcept {
+        std::size_t winner = nodes_[0];
+        for (std::size_t node = (leaves_ + winner) / 2; node != 0; node /= 2)
+            if (beats(nodes_[node], winner))
+                std::swap(nodes_[node], winner);
+        nodes_[0] = winner;
+    }
+
+  private:
+    std::size_t leaves_ = 0;
+    std::vector<std::size_t> nodes_; ///< `nodes_[0]` is the overall winner, the rest are losers of their matches
+};
+
+/// @brief  External sort of 32-bit integers between memory-mapped files, within a memory budget.
+class external_sort_t {
+  public:
+    explicit external_sort_t(std::size_t memory_limit)
+        : run_keys_(std::max<std::size_t>(memory_limit / sizeof(std::int32_t), 1)),
+          buffer_(new std::int32_t[run_keys_]) {}
+
+    /// @return  The number of sorted runs that were merged.
+    template <typename execution_policy_at>
+    std::size_t operator()(execution_policy_at &&policy, mapped_file_t const &input, mapped_file_t const &runs,
+                           mapped_file_t const &output, std::size_t count) {
+        std::size_t const runs_count = (count + run_keys_ - 1) / run_keys_;
+        std::int32_t const *keys = input.as<std::int32_t const>();
+        std::int32_t *sorted_runs = runs.as<std::int32_t>();
+
+        // Phase 1: sort the runs in memory, and spill them. Once a range is copied, we drop its pages
+        // from our address space. The dirty ones will be written back by the kernel in the background.
+        for (std::size_t run = 0; run != runs_count; ++run) {
+            std::size_t const first = run * run_keys_, length = std::min(run_keys_, count - first);
+            std::copy(policy, keys + first, keys + first + length, buffer_.get());
+            input.advise(first * sizeof(std::int32_t), length * sizeof(std::int32_t), MADV_DONTNEED);
+            std::sort(policy, buffer_.get(), buffer_.get() + length);
+            std::copy(policy, buffer_.get(), buffer_.get() + length, sorted_runs + first);
+            runs.advise(first * sizeof(std::int32_t), length * sizeof(std::int32_t), MADV_DONTNEED);
+        }
+
+        // Phase 2: merge all the runs. Each of them is read sequentially, so we ask the kernel to prefetch
+        // the next window of every run, as soon as we start consuming the current one. Half of the budget
+        // is spread between those readahead windows, rounded to whole 64 KB blocks of pages.
+        std::size_t const granularity = 1 << 16;
+        std::size_t const window_budget = run_keys_ * sizeof(std::int32_t) / 2 / runs_count;
+        std::size_t const window_bytes = std::max(window_budget / granularity, std::size_t(1)) * granularity;
+        std::size_t const window_keys = window_bytes / sizeof(std::int32_t);
+        runs.advise(0, count * sizeof(std::int32_t), MADV_SEQUENTIAL);
+        output.advise(0, count * sizeof(std::int32_t), MADV_SEQUENTIAL);
+
+        struct cursor_t {
+            std::int32_t const *current, *end, *next_window;
+        };
+        std::vector<cursor_t> cursors(runs_count);
+        for (std::size_t run = 0; run != runs_count; ++run) {
+            std::size_t const first = run * run_keys_, length = std::min(run_keys_, count - first);
+            cursors[run] = {sorted_runs + first, sorted_runs + first + length, sorted_runs + first};
+        }
+        // Entering a window, we prefetch the one after it, and drop the one before it.
+        auto enter_window = [&](cursor_t &cursor) noexcept {
+            std::size_t const offset = static_cast<std::size_t>(cursor.next_window - sorted_runs);
+            runs.advise((offset + window_keys) * sizeof(std::int32_t), window_bytes, MADV_WILLNEED);
+            if (offset % run_keys_ != 0)
+                runs.advise((offset - window_keys) * sizeof(std::int32_t), window_bytes, MADV_DONTNEED);
+            cursor.next_window = std::min(cursor.next_window + window_keys, cursor.end);
+        };
+        for (cursor_t &cursor : cursors) {
+            runs.advise(static_cast<std::size_t>(cursor.current - sorted_runs) * sizeof(std::int32_t), window_bytes,
+                        MADV_WILLNEED);
+            enter_window(cursor);
+        }
+
+        // Exhausted runs lose every match, and ties are broken by the run index to keep the order strict.
+        auto beats = [&](std::size_t a, std::size_t b) noexcept {
+            cursor_t const &first = cursors[a], &second = cursors[b];
+            if (first.current == first.end)
+                return false;
+            if (second.current == second.end)
+                return true;
+            return *first.current < *second.current || (*first.current == *second.current && a < b);
+        };
+        loser_tree_t tree;
+        tree.build(runs_count, beats);
+
+        std::int32_t *merged = output.as<std::int32_t>();
+        for (std::size_t i = 0; i != count; ++i) {
+            cursor_t &cursor = cursors[tree.winner()];
+            merged[i] = *cursor.current++;
+            if (cursor.current == cursor.next_window && cursor.current != cursor.end)
+                enter_window(cursor);
+            tree.replay(beats);
+            // The output is written once and never read back, so it can leave our footprint too.
+            if ((i + 1) % window_keys == 0)
+                output.advise((i + 1 - window_keys) * sizeof(std::int32_t), window_bytes, MADV_DONTNEED);
+        }
+        return runs_count;
+    }
+
+  private:
+    std::size_t run_keys_ = 0;
+    std::unique_ptr<std::int32_t[]> buffer_;
+};
+
+template <typename execution_policy_t> static void super_sort_external(bm::State &state, execution_policy_t &&policy) {
+
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto memory_limit = static_cast<std::size_t>(state.range(1));
+    std::size_t const bytes = count * sizeof(std::int32_t);
+    // The input, the runs and the output are three separate files, 48 GB in total for 4B keys.
+    // Rather than filling up the disk until the allocation fails, we skip the sizes that won't fit.
+    std::size_t const free_space = mapped_file_t::free_space();
+    if (free_space && 3 * bytes > free_space)
+        return state.SkipWithError("Not enough free space in `TMPDIR` for the input, the runs and the output");
+    mapped_file_t input(bytes), runs(bytes), output(bytes);
+    if (!input || !runs || !output)
+        return state.SkipWithError("Can't map temporary files, check the free space in `TMPDIR`");
+    std::int32_t const *keys = input.as<std::int32_t const>(), *sorted = output.as<std::int32_t const>();
+    generate_distribution(policy, input.as<std::int32_t>(), count, distribution_uniform_k);
+    external_sort_t sorter(memory_limit);
+
+    std::size_t runs_count = 0;
+    for (auto _ : state) {
+        runs_count = sorter(policy, input, runs, output, count);
+        bm::DoNotOptimize(output.as<std::int32_t>());
+    }
+
+    // A merge that drops or duplicates keys can still produce a sorted output, so the sums are compared too.
+    // Both files are streamed once more, but outside of the timed loop.
+    auto sum = [&](std::int32_t const *data) {
+        return std::transform_reduce(policy, data, data + count, std::uint64_t(0), std::plus<>{},
+                                     [](std::int32_t key) { return static_cast<std::uint64_t>(key); });
+    };
+    if (!std::is_sorted(policy, sorted, sorted + count) || sum(keys) != sum(sorted))
+        return state.SkipWithError("The output is not a sorted permutation of the input");
+
+    // The bytes processed per second are the throughput of sorted output, in GB/s.
+    state.SetComplexityN(count);
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(bytes * state.iterations());
+    state.counters["runs"] = static_cast<double>(runs_count);
+}
+
+#ifdef __cpp_lib_parallel_algorithm
+
+// The same 1M to 4B sweep, as `super_sort`, but with a 64 MB and a 1 GB memory budget.
+// Up to 256 runs are merged at the largest size. The disk I/O isn't accounted as CPU time,
+// so the wall-clock time is the only meaningful metric here. Sizes, that don't fit into the free space
+// of `TMPDIR` three times, are skipped.
+BENCHMARK_CAPTURE(super_sort_external, seq, std::execution::seq)
+    ->ArgsProduct({bm::CreateRange(1l << 20, 1l << 32, 8), {64l << 20, 1l << 30}})
+    ->ArgNames({"count", "memory_limit"})
+    ->MinTime(10)
+    ->UseRealTime();
+
+BENCHMARK_CAPTURE(super_sort_external, par_unseq, std::execution::par_unseq)
+    ->ArgsProduct({bm::CreateRange(1l << 20, 1l << 32, 8), {64l << 20, 1l << 30}})
+    ->ArgNames({"count", "memory_limit"})
+    ->MinTime(10)
+    ->UseRealTime();
+
+#endif
+#endif // defined(__unix__) || defined(__APPLE__)
+
+// ------------------------------------
+// ## Work-Stealing Thread Pool
+// ------------------------------------
+//
+// The parallel policies of the standard library are black boxes, backed by TBB in GCC.
+// Underneath, most task schedulers share the same design: every thread owns a double-ended queue of tasks.
+// The owner pushes and pops new tasks on the bottom end, like a call stack, staying in its own warm caches.
+// Idle threads steal from the top end of a random victim, taking the oldest and usually largest tasks.
+// The Chase-Lev deque makes the owner's operations almost free, and only contends on the last task.
+// https://fzn.fr/readings/ppopp13.pdf
+
+/// A logical CPU, as seen by the OS scheduler, with the physical core and the socket it belongs to.
+struct logical_cpu_t {
+    int id = -1; ///< Negative, if the OS doesn't let us pin threads
+    std::size_t core = 0;
+    std::size_t package = 0;
+    std::size_t l3 = 0; ///< Last-level cache, shared by a CCX on AMD, or by the whole socket on most Intel CPUs
+};
+
+/// @brief  Lists the logical CPUs this process may run on: one per physical core first, then their SMT siblings.
+///         Hyper-threads share the caches and the execution ports of their core, so they are the last to be used.
+inline std::vector<logical_cpu_t> available_cpus() {
+    std::vector<logical_cpu_t> cpus;
+#if defined(__linux__)
+    // Containers and `taskset` may restrict us to a subset of the machine.
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (::sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        for (int id = 0; id != CPU_SETSIZE; ++id) {
+            if (!CPU_ISSET(id, &allowed))
+                continue;
+            std::string const topology = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+            logical_cpu_t cpu;
+            cpu.id = id;
+            cpu.core = read_file_contents(topology + "core_id");
+            cpu.package = read_file_contents(topology + "physical_package_id");
+            cpu.l3 = read_file_contents("/sys/devices/system/cpu/cpu" + std::to_string(id) + "/cache/index3/id");
+            cpus.push_back(cpu);
+        }
+#endif
+    if (cpus.empty())
+        cpus.resize(std::max(1u, std::thread::hardware_concurrency()));
+
+    // Rank every logical CPU among the siblings on its core, and move the higher ranks to the back.
+    std::vector<std::size_t> ranks(cpus.size());
+    for (std::size_t i = 0; i != cpus.size(); ++i)
+        for (std::size_t j = 0; j != i; ++j)
+            ranks[i] += cpus[j].id >= 0 && cpus[j].core == cpus[i].core && cpus[j].package == cpus[i].package;
+    std::vector<std::size_t> order(cpus.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return ranks[a] < ranks[b]; });
+    std::vector<logical_cpu_t> ordered(cpus.size());
+    for (std::size_t i = 0; i != cpus.size(); ++i)
+        ordered[i] = cpus[order[i]];
+    return ordered;
+}
+
+/// Pins the calling thread to one logical CPU. Returns false, if the platform doesn't support it.
+inline bool pin_current_thread(logical_cpu_t const &cpu) noexcept {
+#if defined(__linux__)
+    if (cpu.id < 0)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu.id, &set);
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+/// Lets the calling thread migrate between any of the given logical CPUs, undoing a `pin_current_thread`.
+inline bool pin_current_thread(std::vector<logical_cpu_t> const &cpus) noexcept {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (logical_cpu_t const &cpu : cpus)
+        if (cpu.id >= 0)
+            CPU_SET(cpu.id, &set);
+    return CPU_COUNT(&set) != 0 && ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+/// @brief  Bounded Chase-Lev work-stealing deque of pointers, with the memory orders from Le et al. (2013).
+///         Only the owner thread may `push` and `pop`, any thread may `steal`.
+template <typename element_at, std::size_t capacity_ak> class chase_lev_deque_gt {
+    static_assert((capacity_ak & (capacity_ak - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_pointer<element_at>::value, "Null pointers mark the failed operations");
+
+    alignas(64) std::atomic<std::int64_t> top_{0};
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+    alignas(64) std::atomic<element_at> slots_[capacity_ak]{};
+
+  public:
+    /// Returns false if the deque is full, and the caller should run the task itself.
+    bool push(element_at element) noexcept {
+        std::int64_t const bottom = bottom_.load(std::memory_order_relaxed);
+        std::int64_t const top = top_.load(std::memory_order_acquire);
+        if (bottom - top >= static_cast<std::int64_t>(capacity_ak))
+            return false;
+        slots_[bottom & (capacity_ak - 1)].store(element, std::memory_order_relaxed);
+        // A release store, instead of the paper's release fence, is just as cheap and visible to sanitizers.
+        bottom_.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Takes the newest element, competing with the thieves only for the very last one.
+    element_at pop() noexcept {
+        std::int64_t const bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t top = top_.load(std::memory_order_relaxed);
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        element_at element = slots_[bottom & (capacity_ak - 1)].load(std::memory_order_relaxed);
+        if (top == bottom) {
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                element = nullptr;
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return element;
+    }
+
+    /// Takes the oldest element. Returns null if the deque is empty, or if another thread won the race.
+    element_at steal() noexcept {
+        std::int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t const bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom)
+            return nullptr;
+        element_at element = slots_[top & (capacity_ak - 1)].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return element;
+    }
+};
+
+/// @brief  A minimal work-stealing pool with fork-join `parallel_invoke` and `parallel_for`.
+///
+/// The thread that calls into the pool becomes its first worker for the duration of the call,
+/// and only one outside thread may use the pool at a time. The other workers are pinned to
+/// distinct physical cores first, and sleep on a condition variable while the pool is unused.
+/// Tasks live on the stacks of the threads that fork them, so forking never allocates.
+/// Tasks must not throw.
+class work_stealing_pool_t {
+  public:
+    static constexpr std::size_t deque_capacity_k = 1024;
+
+    explicit work_stealing_pool_t(std::size_t threads = std::thread::hardware_concurrency())
+        : slots_(new slot_t[std::max<std::size_t>(threads, 1)]), threads_(std::max<std::size_t>(threads, 1)) {
+        // Pinning more threads than there are CPUs would stack them on the same cores.
+        std::vector<logical_cpu_t> const cpus = available_cpus();
+        bool const pin = threads_ <= cpus.size();
+        for (std::size_t slot = 0; slot != threads_; ++slot)
+            slots_[slot].random = splitmix64(slot);
+        for (std::size_t slot = 1; slot < threads_; ++slot)
+            workers_.emplace_back([this, slot, pin, cpu = cpus[slot % cpus.size()]] {
+                if (pin)
+                    pin_current_thread(cpu);
+                worker_loop_(slot);
+            });
+    }
+
+    ~work_stealing_pool_t() noexcept {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_.store(true, std::memory_order_relaxed);
+        }
+        wake_.notify_all();
+        for (std::thread &worker : workers_)
+            worker.join();
+    }
+
+    work_stealing_pool_t(work_stealing_pool_t const &) = delete;
+    work_stealing_pool_t &operator=(work_stealing_pool_t const &) = delete;
+
+    std::size_t threads() const noexcept { return threads_; }
+
+    /// Runs the `callable` on the calling thread, with the other workers ready to steal its forks.
+    template <typename callable_at> void execute(callable_at &&callable) {
+        if (current_pool_ == this)
+            return callable();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_.fetch_add(1, std::memory_order_relaxed);
+        }
+        wake_.notify_all();
+        current_pool_ = this, current_slot_ = 0;
+        callable();
+        current_pool_ = nullptr;
+        active_.fetch_sub(1, std::memory_order_release);
+    }
+
+    /// Runs both callables, potentially in parallel, and returns once both are done.
+    template <typename left_at, typename right_at> void parallel_invoke(left_at &&left, right_at &&right) {
+        if (current_pool_ != this)
+            return execute([&] { parallel_invoke(left, right); });
+        slot_t &slot = slots_[current_slot_];
+        callable_task_gt<std::remove_reference_t<right_at>> task(right);
+        if (!slot.deque.push(&task)) {
+            left();
+            right();
+            return;
+        }
+        left();
+        // Whatever `left` forked is already joined, so our task is either on top of the deque, or stolen.
+        if (slot.deque.pop() == &task)
+            return right();
+        // While the thief is busy with our task, we help with the others, instead of blocking.
+        while (!task.done.load(std::memory_order_acquire))
+            if (!try_run_one_(current_slot_))
+                std::this_thread::yield();
+    }
+
+    /// Calls `body(first, last)` for disjoint slices of `[0, count)` no longer than `grain`, splitting in halves.
+    template <typename body_at> void parallel_for(std::size_t count, std::size_t grain, body_at &&body) {
+        if (count == 0)
+            return;
+        execute([&] { parallel_for_(0, count, std::max<std::size_t>(grain, 1), body); });
+    }
+
+  private:
+    struct task_t {
+        void (*run)(task_t *) noexcept;
+        std::atomic<bool> done{false};
+    };
+
+    template <typename callable_at> struct callable_task_gt : public task_t {
+        callable_at &callable;
+        explicit callable_task_gt(callable_at &callable) noexcept : task_t{&run_, {false}}, callable(callable) {}
+        static void run_(task_t *task) noexcept {
+            auto *self = static_cast<callable_task_gt *>(task);
+            self->callable();
+            // The forking thread may destroy the task right after this store, so it must come last.
+            self->done.store(true, std::memory_order_release);
+        }
+    };
+
+    struct alignas(64) slot_t {
+        chase_lev_deque_gt<task_t *, deque_capacity_k> deque;
+        std::uint64_t random = 0; ///< State of the victim selection, only touched by the owner
+    };
+
+    std::unique_ptr<slot_t[]> slots_;
+    std::size_t threads_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::atomic<std::size_t> active_{0}; ///< Number of outside calls in progress
+    std::atomic<bool> stop_{false};
+
+    static inline thread_local work_stealing_pool_t *current_pool_ = nullptr;
+    static inline thread_local std::size_t current_slot_ = 0;
+
+    template <typename body_at>
+    void parallel_for_(std::size_t first, std::size_t last, std::size_t grain, body_at &body) {
+        if (last - first <= grain)
+            return body(first, last);
+        std::size_t const middle = first + (last - first) / 2;
+        parallel_invoke([&] { parallel_for_(first, middle, grain, body); },
+                        [&] { parallel_for_(middle, last, grain, body); });
+    }
+
+    /// Runs one task from our own deque or a random victim's. Returns false if found nothing.
+    bool try_run_one_(std::size_t slot) noexcept {
+        task_t *task = slots_[slot].deque.pop();
+        for (std::size_t attempt = 0; !task && attempt != threads_; ++attempt) {
+            std::uint64_t &random = slots_[slot].random;
+            random = splitmix64(random);
+            std::size_t const victim = random % threads_;
+            if (victim != slot)
+                task = slots_[victim].deque.steal();
+        }
+        if (!task)
+            return false;
+        task->run(task);
+        return true;
+    }
+
+    void worker_loop_(std::size_t slot) {
+        current_pool_ = this, current_slot_ = slot;
+        while (!stop_.load(std::memory_order_relaxed)) {
+            if (try_run_one_(slot))
+                continue;
+            if (active_.load(std::memory_order_acquire) != 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_.load(std::memory_order_relaxed) || active_.load() != 0; });
+        }
+    }
+};
+
+// To compare the schedulers, rather than the algorithms, both run the same code, written against a tiny
+// "executor" interface: `execute`, `parallel_invoke`, and `parallel_for`. The pool implements it directly.
+#if defined(TUTORIAL_USE_TBB)
+
+/// Adapts TBB to the same executor interface, confined to an arena with a fixed number of threads.
+class tbb_executor_t {
+    tbb::task_arena arena_;
+
+  public:
+    explicit tbb_executor_t(std::size_t threads) : arena_(static_cast<int>(threads)) {}
+
+    std::size_t threads() const noexcept { return static_cast<std::size_t>(arena_.max_concurrency()); }
+
+    template <typename callable_at> void execute(callable_at &&callable) { arena_.execute(callable); }
+
+    template <typename left_at, typename right_at> void parallel_invoke(left_at &&left, right_at &&right) {
+        arena_.execute([&] { tbb::parallel_invoke(left, right); });
+    }
+
+    /// The simple partitioner splits the range in halves down to the `grain`, just like the pool.
+    template <typename body_at> void parallel_for(std::size_t count, std::size_t grain, body_at &&body) {
+        using range_t = tbb::blocked_range<std::size_t>;
+        arena_.execute([&] {
+            tbb::parallel_for(
+                range_t(0, count, std::max<std::size_t>(grain, 1)),
+                [&](range_t const &range) { body(range.begin(), range.end()); }, tbb::simple_partitioner{});
+        });
+    }
+};
+
+#endif // defined(TUTORIAL_USE_TBB)
+
+/// Reverses in parallel: every slice of the first half is swapped with its mirror in the second half.
+template <typename executor_at, typename element_at>
+void parallel_reverse(executor_at &executor, element_at *begin, element_at *end, std::size_t grain = 1 << 16) {
+    std::size_t const count = static_cast<std::size_t>(end - begin);
+    executor.parallel_for(count / 2, grain, [=](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i != last; ++i)
+            std::swap(begin[i], begin[count - 1 - i]);
+    });
+}
+
+/// @brief  Fork-join merge sort: both halves are sorted in parallel, and then merged in parallel,
+///         by splitting the larger input at its median, and the smaller one at the same key.
+template <typename element_at> struct fork_join_merge_sort_gt {
+    static constexpr std::size_t sort_grain_k = 1 << 14;  ///< Inputs sorted by a single task
+    static constexpr std::size_t merge_grain_k = 1 << 14; ///< Outputs merged by a single task
+
+    /// Sorts `[begin, end)`, using the `buffer` of the same size as the second buffer.
+    template <typename executor_at>
+    void operator()(executor_at &executor, element_at *begin, element_at *end, element_at *buffer) const {
+        executor.execute([&] { sort_(executor, begin, buffer, static_cast<std::size_t>(end - begin), false); });
+    }
+
+  private:
+    template <typename executor_at>
+    static void sort_(executor_at &executor, element_at *data, element_at *buffer, std::size_t count,
+                      bool result_in_buffer) {
+        if (count <= sort_grain_k) {
+            std::sort(data, data + count);
+            if (result_in_buffer)
+                std::copy(data, data + count, buffer);
+            return;
+        }
+        // The halves land in the other buffer, so that merging them moves the result where it belongs.
+        std::size_t const half = count / 2;
+        executor.parallel_invoke([&] { sort_(executor, data, buffer, half, !result_in_buffer); },
+                                 [&] { sort_(executor, data + half, buffer + half, count - half, !result_in_buffer); });
+        element_at *from = result_in_buffer ? data : buffer, *to = result_in_buffer ? buffer : data;
+        merge_(executor, from, half, from + half, count - half, to);
+    }
+
+    template <typename executor_at>
+    static void merge_(executor_at &executor, element_at const *a, std::size_t a_count, element_at const *b,
+                       std::size_t b_count, element_at *output) {
+        if (a_count + b_count <= merge_grain_k) {
+            std::merge(a, a + a_count, b, b + b_count, output);
+            return;
+        }
+        if (a_count < b_count)
+            std::swap(a, b), std::swap(a_count, b_count);
+        std::size_t const a_middle = a_count / 2;
+        std::size_t const b_middle = static_cast<std::size_t>(std::lower_bound(b, b + b_count, a[a_middle]) - b);
+        executor.parallel_invoke([&] { merge_(executor, a, a_middle, b, b_middle, output); },
+                                 [&] {
+                                     merge_(executor, a + a_middle, a_count - a_middle, b + b_middle,
+                                            b_count - b_middle, output + a_middle + b_middle);
+                                 });
+    }
+};
+
+/// Powers of two up to the `limit`, and the `limit` itself, which defaults to the number of hardware threads.
+inline std::vector<std::int64_t> thread_counts(std::int64_t limit = std::thread::hardware_concurrency()) {
+    limit = std::max<std::int64_t>(1, limit);
+    std::vector<std::int64_t> counts;
+    for (std::int64_t threads = 1; threads < limit; threads *= 2)
+        counts.push_back(threads);
+    counts.push_back(limit);
+    return counts;
+}
+
+/// @brief  Reports the threads and the scaling efficiency against the same executor with a single thread.
+///         Only the `single_thread_run` is timed, while `prepare` restores its input before every run.
+template <typename executor_at, typename prepare_at, typename callable_at>
+void report_scaling(bm::State &state, std::string const &name, std::size_t count, double seconds, prepare_at &&prepare,
+                    callable_at &&single_thread_run) {
+    std::size_t const threads = static_cast<std::size_t>(state.range(1));
+    executor_at single_thread(1);
+    double const single_thread_seconds = prepared_reference_seconds(
+        name + "/1_thread", count, prepare, [&] { single_thread_run(single_thread); }, 5);
+    double const speedup = single_thread_seconds / (seconds / state.iterations());
+    state.counters["threads"] = static_cast<double>(threads);
+    state.counters["speedup"] = speedup;
+    state.counters["scaling_efficiency"] = speedup / threads;
+}
+
+template <typename executor_at> static void executor_reverse(bm::State &state, std::in_place_type_t<executor_at>) {
+    auto count = static_cast<std::size_t>(state.range(0));
+    executor_at executor(static_cast<std::size_t>(state.range(1)));
+    std::vector<std::int32_t> array(count);
+    std::iota(array.begin(), array.end(), 0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        parallel_reverse(executor, array.data(), array.data() + count);
+        bm::DoNotOptimize(array.data());
+    }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    state.SetBytesProcessed(count * state.iterations() * sizeof(std::int32_t));
+    report_scaling<executor_at>(
+        state, std::string("executor_reverse/") + typeid(executor_at).name(), count, seconds, [] {},
+        [&](executor_at &single_thread) { parallel_reverse(single_thread, array.data(), array.data() + count); });
+}
+
+template <typename executor_at> static void executor_sort(bm::State &state, std::in_place_type_t<executor_at>) {
+    auto count = static_cast<std::size_t>(state.range(0));
+    executor_at executor(static_cast<std::size_t>(state.range(1)));
+    std::vector<std::int32_t> array(count), buffer(count);
+    fork_join_merge_sort_gt<std::int32_t> sorter;
+
+    double seconds = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        generate_distribution(array.data(), count, distribution_uniform_k);
+        state.ResumeTiming();
+        auto start = std::chrono::steady_clock::now();
+        sorter(executor, array.data(), array.data() + count, buffer.data());
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bm::DoNotOptimize(array.data());
+    }
+    if (!std::is_sorted(array.begin(), array.end()))
+        return state.SkipWithError("The keys are not sorted");
+    state.SetItemsProcessed(count * state.iterations());
+    report_scaling<executor_at>(
+        state, std::string("executor_sort/") + typeid(executor_at).name(), count, seconds,
+        [&] { generate_distribution(array.data(), count, distribution_uniform_k); },
+        [&](executor_at &single_thread) { sorter(single_thread, array.data(), array.data() + count, buffer.data()); });
+}
+
+// The scheduling overhead is easiest to see on tasks that do nothing at all:
+// a `parallel_for` with a grain of one, and a binary tree of `parallel_invoke` forks.
+template <typename executor_at> static void executor_parallel_for(bm::State &state, std::in_place_type_t<executor_at>) {
+    auto tasks = static_cast<std::size_t>(state.range(0));
+    executor_at executor(static_cast<std::size_t>(state.range(1)));
+    for (auto _ : state)
+        executor.parallel_for(tasks, 1, [](std::size_t first, std::size_t) { bm::DoNotOptimize(first); });
+    state.counters["threads"] = static_cast<double>(state.range(1));
+    state.counters["seconds_per_task"] =
+        bm::Counter(static_cast<double>(tasks), bm::Counter::kIsIterationInvariantRate | bm::Counter::kInvert);
+}
+
+template <typename executor_at> void fork_tree(executor_at &executor, std::size_t depth) {
+    if (depth == 0)
+        return;
+    executor.parallel_invoke([&] { fork_tree(executor, depth - 1); }, [&] { fork_tree(executor, depth - 1); });
+}
+
+template <typename executor_at>
+static void executor_parallel_invoke(bm::State &state, std::in_place_type_t<executor_at>) {
+    auto depth = static_cast<std::size_t>(state.range(0));
+    executor_at executor(static_cast<std::size_t>(state.range(1)));
+    for (auto _ : state)
+        executor.execute([&] { fork_tree(executor, depth); });
+    state.counters["threads"] = static_cast<double>(state.range(1));
+    state.counters["seconds_per_fork"] = bm::Counter(static_cast<double>((std::size_t(1) << depth) - 1),
+                                                     bm::Counter::kIsIterationInvariantRate | bm::Counter::kInvert);
+}
+
+static void executor_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgsProduct({{1 << 24}, thread_counts()})->ArgNames({"count", "threads"})->UseRealTime();
+}
+static void executor_overhead_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgsProduct({{1 << 16}, thread_counts()})->ArgNames({"tasks", "threads"})->UseRealTime();
+}
+static void executor_fork_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgsProduct({{16}, thread_counts()})->ArgNames({"depth", "threads"})->UseRealTime();
+}
+
+BENCHMARK_CAPTURE(executor_reverse, pool, std::in_place_type<work_stealing_pool_t>)->Apply(executor_arguments);
+BENCHMARK_CAPTURE(executor_sort, pool, std::in_place_type<work_stealing_pool_t>)->Apply(executor_arguments);
+BENCHMARK_CAPTURE(executor_parallel_for, pool, std::in_place_type<work_stealing_pool_t>)
+    ->Apply(executor_overhead_arguments);
+BENCHMARK_CAPTURE(executor_parallel_invoke, pool, std::in_place_type<work_stealing_pool_t>)
+    ->Apply(executor_fork_arguments);
+
+#if defined(TUTORIAL_USE_TBB)
+
+// TBB steals the same way, but allocates its tasks from pools, and its partitioners and arenas add bookkeeping.
+// On a single thread of a cloud VM, an empty `parallel_for` task costs ~25 ns in our pool and ~55 ns in TBB,
+// and a fork ~20 ns and ~130 ns respectively. On real work, like the reverse and the sort, both perform alike.
+BENCHMARK_CAPTURE(executor_reverse, tbb, std::in_place_type<tbb_executor_t>)->Apply(executor_arguments);
+BENCHMARK_CAPTURE(executor_sort, tbb, std::in_place_type<tbb_executor_t>)->Apply(executor_arguments);
+BENCHMARK_CAPTURE(executor_parallel_for, tbb, std::in_place_type<tbb_executor_t>)->Apply(executor_overhead_arguments);
+BENCHMARK_CAPTURE(executor_parallel_invoke, tbb, std::in_place_type<tbb_executor_t>)->Apply(executor_fork_arguments);
+
+// The `super_sort` runs with `par_unseq` above always occupy every core, and only show the final speedup.
+// To see where scaling degrades, we cap the number of TBB threads with a `tbb::global_control`,
+// sweeping from 1 to all hardware threads, and pin them to the CPUs in one of two orders:
+// - `cores_physical_k`: one thread per physical core, stopping when we run out of cores.
+// - `cores_smt_k`: both hyper-threads of a core before moving to the next one.
+// At equal thread counts, the difference between the two shows what sharing a core costs,
+// and the last `cores_smt_k` point shows what SMT adds on top of all the physical cores.
+// Expect a speedup below 1 on a single thread: GCC's parallel backend runs a merge sort instead of introsort.
+enum cores_t {
+    cores_smt_k,
+    cores_physical_k,
+};
+
+/// Orders the logical CPUs, so that the first N of them are the ones a sweep uses for N threads.
+inline std::vector<logical_cpu_t> scaling_cpus(cores_t cores) {
+    std::vector<logical_cpu_t> cpus = available_cpus();
+    std::size_t physical = 0;
+    for (std::size_t i = 0; i != cpus.size(); ++i)
+        physical += std::none_of(cpus.begin(), cpus.begin() + i, [&](logical_cpu_t const &other) {
+            return cpus[i].id >= 0 && other.core == cpus[i].core && other.package == cpus[i].package;
+        });
+    // `available_cpus` lists the physical cores first, so the stable sort keeps them ahead of their siblings.
+    if (cores == cores_physical_k)
+        cpus.resize(physical);
+    else
+        std::stable_sort(cpus.begin(), cpus.end(), [](logical_cpu_t const &a, logical_cpu_t const &b) {
+            return std::make_pair(a.package, a.core) < std::make_pair(b.package, b.core);
+        });
+    return cpus;
+}
+
+/// Pins every thread joining the observed arena to the CPU matching its slot, and unpins it on the way out,
+/// so that the workers returning to TBB's shared pool don't carry our affinity into the other benchmarks.
+class tbb_pinning_observer_t : public tbb::task_scheduler_observer {
+    std::vector<logical_cpu_t> cpus_;
+    std::vector<logical_cpu_t> all_cpus_ = available_cpus();
+
+  public:
+    tbb_pinning_observer_t(tbb::task_arena &arena, std::vector<logical_cpu_t> cpus)
+        : tbb::task_scheduler_observer(arena), cpus_(std::move(cpus)) {
+        observe(true);
+    }
+    ~tbb_pinning_observer_t() override { observe(false); }
+
+    void on_scheduler_entry(bool) override {
+        int const slot = tbb::this_task_arena::current_thread_index();
+        if (slot >= 0)
+            pin_current_thread(cpus_[static_cast<std::size_t>(slot) % cpus_.size()]);
+    }
+    void on_scheduler_exit(bool) override { pin_current_thread(all_cpus_); }
+};
+
+#ifdef __cpp_lib_parallel_algorithm
+
+static void super_sort_scaling(bm::State &state) {
+
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto distribution = static_cast<distribution_t>(state.range(1));
+    auto threads = static_cast<std::size_t>(state.range(2));
+    auto cores = static_cast<cores_t>(state.range(3));
+    std::vector<std::int32_t> array(count);
+    state.SetLabel(std::string(distribution_name(distribution)) + (cores == cores_smt_k ? "/smt" : "/physical"));
+
+    // The sequential reference is timed before we restrict TBB, and only once per size and distribution.
+    std::string const reference_name = std::string("super_sort/seq/") + distribution_name(distribution);
+    double const seq_seconds = prepared_reference_seconds(
+        reference_name, count, [&] { generate_distribution(array.data(), count, distribution); },
+        [&] { std::sort(std::execution::seq, array.begin(), array.end()); });
+
+    // The `global_control` limits all of TBB, including the default arena of the input generation,
+    // while the arena of the same size lets our observer see the threads of the sort.
+    tbb::global_control limit(tbb::global_control::max_allowed_parallelism, threads);
+    tbb::task_arena arena(static_cast<int>(threads));
+    tbb_pinning_observer_t pinning(arena, scaling_cpus(cores));
+
+    // Only the sort is reported as the iteration time, so the throughput counters exclude the generation too.
+    double sort_seconds = 0;
+    for (auto _ : state) {
+        generate_distribution(std::execution::par_unseq, array.data(), count, distribution);
+        auto start = std::chrono::steady_clock::now();
+        arena.execute([&] { std::sort(std::execution::par_unseq, array.begin(), array.end()); });
+        double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        state.SetIterationTime(seconds);
+        sort_seconds += seconds;
+        bm::DoNotOptimize(array.size());
+    }
+    if (!std::is_sorted(array.begin(), array.end()))
+        return state.SkipWithError("The keys are not sorted");
+
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(count * state.iterations() * sizeof(std::int32_t));
+    double const speedup = seq_seconds / (sort_seconds / state.iterations());
+    state.counters["threads"] = static_cast<double>(threads);
+    state.counters["speedup"] = speedup;
+    state.counters["parallel_efficiency"] = speedup / threads;
+}
+
+static void super_sort_scaling_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"count", "distribution", "threads", "cores"});
+    for (cores_t cores : {cores_smt_k, cores_physical_k})
+        for (std::int64_t count : {1l << 20, 1l << 24})
+            for (std::int64_t threads : thread_counts(static_cast<std::int64_t>(scaling_cpus(cores).size())))
+                benchmark->Args({count, distribution_uniform_k, threads, cores});
+}
+
+BENCHMARK(super_sort_scaling)->Apply(super_sort_scaling_arguments)->MinTime(2)->UseManualTime();
+
+#endif
+
+#endif // defined(TUTORIAL_USE_TBB)
+
+// ------------------------------------
+// ## Sorting Floating-Point Keys
+// ------------------------------------
+//
+// Radix sort works on bits, and IEEE-754 bits almost sort themselves: for non-negative numbers,
+// a larger exponent or a larger mantissa means a larger value, so their bit patterns compare like integers.
+// Two fixes make that true for all numbers:
+// - Negative numbers are stored as sign and magnitude, so their order is reversed: flip all of their bits.
+// - Positive numbers must land above all the negatives: flip just their sign bit.
+// That maps `-0.0` just below `+0.0`, denormals between zeros and normals, and infinities to the extremes.
+// NaNs have many bit patterns, and can be negative, so we canonicalize them to one positive quiet NaN,
+// that sorts after `+inf`. Just like `std::sort` with a "total order" comparator, but with no comparisons.
+// http://stereopsis.com/radix.html
+
+template <typename float_at> struct ieee_traits_gt;
+template <> struct ieee_traits_gt<float> { using bits_t = std::uint32_t; };
+template <> struct ieee_traits_gt<double> { using bits_t = std::uint64_t; };
+template <typename float_at> using ieee_bits_t = typename ieee_traits_gt<float_at>::bits_t;
+
+/// @brief  Maps the bits of a floating-point number to an unsigned integer with the same order.
+///         Only uses integer operations, as moving every key between vector and scalar registers,
+///         for a `std::isnan` check, is noticeably slower in the hot loops of the radix sort.
+template <typename float_at> ieee_bits_t<float_at> ieee_bits_to_ordered(ieee_bits_t<float_at> bits) noexcept {
+    using bits_t = ieee_bits_t<float_at>;
+    constexpr std::size_t sign_shift = sizeof(bits_t) * CHAR_BIT - 1;
+    constexpr std::size_t mantissa_bits = std::numeric_limits<float_at>::digits - 1;
+    constexpr bits_t sign_mask = bits_t(1) << sign_shift;
+    constexpr bits_t infinity_bits = sign_mask - (bits_t(1) << mantissa_bits);
+    // Every magnitude above the infinity is a NaN. The canonical one is positive and quiet.
+    constexpr bits_t canonical_nan = infinity_bits | (bits_t(1) << (mantissa_bits - 1));
+    bits = (bits & ~sign_mask) > infinity_bits ? canonical_nan : bits;
+    bits_t const mask = static_cast<bits_t>(0 - (bits >> sign_shift)) | sign_mask;
+    return bits ^ mask;
+}
+
+/// Maps a floating-point number to an unsigned integer with the same order, canonicalizing NaNs.
+template <typename float_at> ieee_bits_t<float_at> ieee_to_ordered(float_at x) noexcept {
+    ieee_bits_t<float_at> bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return ieee_bits_to_ordered<float_at>(bits);
+}
+
+/// The inverse of `ieee_to_ordered`.
+template <typename float_at> float_at ieee_from_ordered(ieee_bits_t<float_at> ordered) noexcept {
+    using bits_t = ieee_bits_t<float_at>;
+    constexpr std::size_t sign_shift = sizeof(bits_t) * CHAR_BIT - 1;
+    bits_t const mask = static_cast<bits_t>((ordered >> sign_shift) - 1) | (bits_t(1) << sign_shift);
+    bits_t const bits = ordered ^ mask;
+    float_at x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+/// `std::sort` with a total-order comparator, producing the same order as the radix sort below.
+/// The default `operator<` is faster, but isn't a strict weak ordering in the presence of NaNs.
+template <typename float_at> struct ieee_std_sort_gt {
+    using element_t = float_at;
+    /// Takes a memory resource, like the radix sorts, but `std::sort` needs no scratch memory.
+    explicit ieee_std_sort_gt(std::pmr::memory_resource * = nullptr) noexcept {}
+    void operator()(float_at *begin, float_at *end) const noexcept {
+        std::sort(begin, end, [](float_at a, float_at b) { return ieee_to_ordered(a) < ieee_to_ordered(b); });
+    }
+};
+
+/// @brief  Least Significant Digit (LSD) radix sort for `float` and `double`, with 8-bit digits.
+/// @tparam fused_ak  Whether to apply the bit transforms within the first and the last scatter passes,
+///                   instead of spending two more passes over memory, before and after sorting.
+///
+/// The histograms of all the digits are built in a single read-only pass. Passes, where all keys share
+/// the same digit, are skipped, which is common for the exponent bytes of narrow distributions.
+/// Like `radix_sort_t`, it borrows the second buffer from a memory resource on every call.
+template <typename float_at, bool fused_ak> class ieee_radix_sort_gt {
+  public:
+    using element_t = float_at;
+    using bits_t = ieee_bits_t<float_at>;
+    static constexpr std::size_t bits_per_pass_k = 8;
+    static constexpr std::size_t buckets_k = 1 << bits_per_pass_k;
+    static constexpr std::size_t passes_k = sizeof(bits_t) * CHAR_BIT / bits_per_pass_k;
+
+    explicit ieee_radix_sort_gt(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) noexcept
+        : resource_(resource) {}
+
+    void operator()(float_at *begin, float_at *end) {
+        std::size_t const count = static_cast<std::size_t>(end - begin);
+        scratch_buffer_gt<bits_t> buffer(count, resource_);
+        std::byte *const data = reinterpret_cast<std::byte *>(begin);
+
+        // Without fusion, the keys are replaced by their ordered bits in place, and restored at the end.
+        if constexpr (!fused_ak)
+            for (std::size_t i = 0; i != count; ++i)
+                store_(data, i, ieee_to_ordered(begin[i]));
+
+        std::array<std::array<std::size_t, buckets_k>, passes_k> histograms{};
+        for (std::size_t i = 0; i != count; ++i) {
+            bits_t const raw = load_<bits_t>(data, i);
+            bits_t const bits = fused_ak ? ieee_bits_to_ordered<float_at>(raw) : raw;
+            for (std::size_t pass = 0; pass != passes_k; ++pass)
+                ++histograms[pass][(bits >> (pass * bits_per_pass_k)) & (buckets_k - 1)];
+        }
+        std::size_t active_passes[passes_k], active_count = 0;
+        for (std::size_t pass = 0; pass != passes_k; ++pass)
+            if (std::find(histograms[pass].begin(), histograms[pass].end(), count) == histograms[pass].end())
+                active_passes[active_count++] = pass;
+
+        std::byte *from = data, *to = reinterpret_cast<std::byte *>(buffer.data());
+        for (std::size_t active = 0; active != active_count; ++active) {
+            std::size_t const pass = active_passes[active];
+            std::array<std::size_t, buckets_k> offsets;
+            std::exclusive_scan(histograms[pass].begin(), histograms[pass].end(), offsets.begin(), std::size_t(0));
+            bool const transform_in = fused_ak && active == 0, transform_out = fused_ak && active + 1 == active_count;
+            if (transform_in && transform_out)
+                scatter_<true, true>(from, to, count, pass * bits_per_pass_k, offsets);
+            else if (transform_in)
+                scatter_<true, false>(from, to, count, pass * bits_per_pass_k, offsets);
+            else if (transform_out)
+                scatter_<false, true>(from, to, count, pass * bits_per_pass_k, offsets);
+            else
+                scatter_<false, false>(from, to, count, pass * bits_per_pass_k, offsets);
+            std::swap(from, to);
+        }
+        if (from != data)
+            std::memcpy(data, from, count * sizeof(bits_t));
+
+        // If every pass was skipped, the fused variant still has to canonicalize the NaNs.
+        if constexpr (fused_ak) {
+            if (active_count == 0)
+                for (std::size_t i = 0; i != count; ++i)
+                    begin[i] = ieee_from_ordered<float_at>(ieee_to_ordered(begin[i]));
+        } else {
+            for (std::size_t i = 0; i != count; ++i)
+                begin[i] = ieee_from_ordered<float_at>(load_<bits_t>(data, i));
+        }
+    }
+
+  private:
+    std::pmr::memory_resource *resource_;
+
+    /// Intermediate passes keep integer bits in the floats' storage, so we copy object representations.
+    template <typename value_at> static value_at load_(std::byte const *base, std::size_t i) noexcept {
+        value_at value;
+        std::memcpy(&value, base + i * sizeof(value_at), sizeof(value_at));
+        return value;
+    }
+    template <typename value_at> static void store_(std::byte *base, std::size_t i, value_at value) noexcept {
+        std::memcpy(base + i * sizeof(value_at), &value, sizeof(value_at));
+    }
+
+    template <bool transform_in_ak, bool transform_out_ak>
+    static void scatter_(std::byte const *from, std::byte *to, std::size_t count, std::size_t shift,
+                         std::array<std::size_t, buckets_k> &offsets) noexcept {
+        for (std::size_t i = 0; i != count; ++i) {
+            bits_t const raw = load_<bits_t>(from, i);
+            bits_t const bits = transform_in_ak ? ieee_bits_to_ordered<float_at>(raw) : raw;
+            std::size_t const position = offsets[(bits >> shift) & (buckets_k - 1)]++;
+            if constexpr (transform_out_ak)
+                store_(to, position, ieee_from_ordered<float_at>(bits));
+            else
+                store_(to, position, bits);
+        }
+    }
+};
+
+/// Floating-point inputs, that stress the corner cases of the bit transforms.
+enum ieee_distribution_t : std::int64_t {
+    ieee_uniform_k,      ///< Uniform in `(-1, 1)`, with a narrow range of exponents
+    ieee_wide_k,         ///< Random bits of finite numbers, with all possible exponents
+    ieee_denormal_k,     ///< Only subnormal numbers and zeros of both signs
+    ieee_signed_zeros_k, ///< Half of the keys are `-0.0` or `+0.0`, the rest are uniform
+    ieee_specials_k,     ///< Uniform, mixed with infinities and NaNs of both signs and random payloads
+    ieee_reversed_k,     ///< Descending, crossing zero
+    ieee_distributions_count_k,
+};
+
+inline char const *ieee_distribution_name(ieee_distribution_t distribution) noexcept {
+    switch (distribution) {
+    case ieee_uniform_k:
+        return "uniform";
+    case ieee_wide_k:
+        return "wide";
+    case ieee_denormal_k:
+        return "denormal";
+    case ieee_signed_zeros_k:
+        return "signed_zeros";
+    case ieee_specials_k:
+        return "nans_and_infinities";
+    case ieee_reversed_k:
+        return "reversed";
+    default:
+        return "unknown";
+    }
+}
+
+template <typename float_at>
+void generate_ieee_distribution(float_at *data, std::size_t count, ieee_distribution_t distribution,
+                                std::uint64_t seed = 42) noexcept {
+    using bits_t = ieee_bits_t<float_at>;
+    constexpr std::size_t mantissa_bits = std::numeric_limits<float_at>::digits - 1;
+    constexpr bits_t sign_mask = bits_t(1) << (sizeof(bits_t) * CHAR_BIT - 1);
+    constexpr bits_t mantissa_mask = (bits_t(1) << mantissa_bits) - 1;
+    constexpr bits_t exponent_mask = static_cast<bits_t>(~(sign_mask | mantissa_mask));
+    auto from_bits = [](bits_t bits) noexcept {
+        float_at x;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    };
+    auto uniform = [](std::uint64_t random) noexcept {
+        float_at const magnitude = static_cast<float_at>(static_cast<double>(random >> 11) * 0x1.0p-53);
+        return (random & 1) ? -magnitude : magnitude;
+    };
+
+    for (std::size_t i = 0; i != count; ++i) {
+        std::uint64_t const random = splitmix64(seed ^ splitmix64(i));
+        bits_t const bits = static_cast<bits_t>(random);
+        switch (distribution) {
+        case ieee_uniform_k:
+            data[i] = uniform(random);
+            break;
+        case ieee_wide_k:
+            // An all-ones exponent would encode infinities and NaNs, so we clear its lowest bit.
+            data[i] = from_bits((bits & exponent_mask) == exponent_mask ? bits ^ (bits_t(1) << mantissa_bits) : bits);
+            break;
+        case ieee_denormal_k:
+            data[i] = from_bits(bits & (sign_mask | mantissa_mask));
+            break;
+        case ieee_signed_zeros_k:
+            data[i] = (random & 2) ? uniform(random) : ((random & 1) ? -float_at(0) : float_at(0));
+            break;
+        case ieee_specials_k:
+            switch ((random >> 1) % 8) {
+            case 0:
+                data[i] = from_bits((bits & sign_mask) | exponent_mask | ((bits | 1) & mantissa_mask));
+                break;
+            case 1:
+                data[i] = (random & 1) ? -std::numeric_limits<float_at>::infinity()
+                                       : std::numeric_limits<float_at>::infinity();
+                break;
+            default:
+                data[i] = uniform(random);
+                break;
+            }
+            break;
+        case ieee_reversed_k:
+            data[i] = static_cast<float_at>(count / 2) - static_cast<float_at>(i);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+template <typename sorter_at> static void sorting_ieee(bm::State &state) {
+    using element_t = typename sorter_at::element_t;
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto distribution = static_cast<ieee_distribution_t>(state.range(1));
+    std::vector<element_t> original(count), array(count);
+    generate_ieee_distribution(original.data(), count, distribution);
+    state.SetLabel(ieee_distribution_name(distribution));
+    // The arena keeps the radix sort's second buffer between iterations.
+    arena_resource_t arena;
+    sorter_at sorter(&arena);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::copy(original.begin(), original.end(), array.begin());
+        state.ResumeTiming();
+        sorter(array.data(), array.data() + count);
+        arena.reset();
+        bm::DoNotOptimize(array.data());
+    }
+
+    // Every key must match the comparator-based sort bit for bit, including the signs of zeros.
+    // Only NaNs may differ, as the radix sorts canonicalize their payloads and signs.
+    ieee_std_sort_gt<element_t>{}(original.data(), original.data() + count);
+    for (std::size_t i = 0; i != count; ++i) {
+        bool const matches = std::isnan(original[i]) ? std::isnan(array[i])
+                                                     : std::memcmp(&original[i], &array[i], sizeof(element_t)) == 0;
+        if (!matches)
+            return state.SkipWithError("The result differs from the total-order `std::sort`");
+    }
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(count * state.iterations() * sizeof(element_t));
+}
+
+static void sorting_ieee_arguments(bm::internal::Benchmark *benchmark) {
+    std::vector<std::int64_t> distributions(ieee_distributions_count_k);
+    std::iota(distributions.begin(), distributions.end(), 0);
+    benchmark->ArgsProduct({{1 << 20, 1 << 24}, distributions});
+}
+
+// Radix sort is O(N) for a fixed key width, and beats the comparator-based `std::sort` by 5-15x.
+// Every pass streams the whole array through memory, and fusing the transforms saves 2 of the 7 passes
+// for floats, and 2 of the 11 for doubles. It matters most once the array no longer fits in the caches.
+BENCHMARK_TEMPLATE(sorting_ieee, ieee_std_sort_gt<float>)->Apply(sorting_ieee_arguments);
+BENCHMARK_TEMPLATE(sorting_ieee, ieee_radix_sort_gt<float, false>)->Apply(sorting_ieee_arguments);
+BENCHMARK_TEMPLATE(sorting_ieee, ieee_radix_sort_gt<float, true>)->Apply(sorting_ieee_arguments);
+BENCHMARK_TEMPLATE(sorting_ieee, ieee_std_sort_gt<double>)->Apply(sorting_ieee_arguments);
+BENCHMARK_TEMPLATE(sorting_ieee, ieee_radix_sort_gt<double, false>)->Apply(sorting_ieee_arguments);
+BENCHMARK_TEMPLATE(sorting_ieee, ieee_radix_sort_gt<double, true>)->Apply(sorting_ieee_arguments);
+
+// ------------------------------------
+// ## Sorting Strings
+// ------------------------------------
+//
+// Strings are the opposite of integers: the keys live out-of-line, have variable lengths, and often share long
+// prefixes. Every comparison in `std::sort` chases two pointers and re-reads those common prefixes,
+// so the cost is dominated by cache misses rather than by instructions. There are two classic fixes:
+// - Inspect one byte at a time, and never look at a settled prefix again: multikey quicksort and MSD radix sort.
+// - Keep the first bytes of every string next to its pointer, so most comparisons never leave the array.
+// https://www.cs.princeton.edu/~rs/strings/paper.pdf
+
+/// Hardware events, that can be counted with `perf_counter_t`.
+enum perf_event_t {
+    perf_cycles_k,
+    perf_instructions_k,
+    perf_cache_misses_k,
+    perf_branch_misses_k,
+};
+
+/// @brief  Counts a hardware event on the calling thread with the Linux `perf_event_open` interface.
+///         Google Benchmark can do the same with `--benchmark_perf_counters`, but only if built with `libpfm`.
+///         Virtual machines and containers often hide the PMU, so check `operator bool` before reporting.
+class perf_counter_t {
+    int descriptor_ = -1;
+
+  public:
+    explicit perf_counter_t(perf_event_t event) noexcept {
+#if defined(__linux__)
+        std::uint64_t configs[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                   PERF_COUNT_HW_BRANCH_MISSES};
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.size = sizeof(attributes);
+        attributes.config = configs[event];
+        attributes.disabled = 1;
+        // The default `perf_event_paranoid` level only allows user-space events of our own process.
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        descriptor_ = static_cast<int>(::syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#else
+        (void)event;
+#endif
+    }
+    ~perf_counter_t() noexcept {
+#if defined(__linux__)
+        if (descriptor_ >= 0)
+            ::close(descriptor_);
+#endif
+    }
+    perf_counter_t(perf_counter_t const &) = delete;
+    perf_counter_t &operator=(perf_counter_t const &) = delete;
+
+    explicit operator bool() const noexcept { return descriptor_ >= 0; }
+
+    /// Resumes counting, accumulating on top of the previous value.
+    void start() noexcept {
+#if defined(__linux__)
+        if (descriptor_ >= 0)
+            ::ioctl(descriptor_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+    void stop() noexcept {
+#if defined(__linux__)
+        if (descriptor_ >= 0)
+            ::ioctl(descriptor_, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+    }
+    std::uint64_t value() const noexcept {
+        std::uint64_t count = 0;
+#if defined(__linux__)
+        if (descriptor_ >= 0 && ::read(descriptor_, &count, sizeof(count)) != sizeof(count))
+            count = 0;
+#endif
+        return count;
+    }
+};
+
+/// String keys with realistic shapes and lengths.
+enum strings_distribution_t : std::int64_t {
+    strings_urls_k,      ///< 20-90 bytes, sharing schemes, hosts from a skewed set, and random paths
+    strings_short_ids_k, ///< 8-16 random alphanumeric bytes, that usually differ in the first byte
+    strings_distributions_count_k,
+};
+
+inline char const *strings_distribution_name(strings_distribution_t distribution) noexcept {
+    switch (distribution) {
+    case strings_urls_k:
+        return "urls";
+    case strings_short_ids_k:
+        return "short_ids";
+    default:
+        return "unknown";
+    }
+}
+
+/// All strings are packed into one arena, and addressed with views, like in most columnar engines.
+struct strings_dataset_t {
+    std::string arena;
+    std::vector<std::string_view> strings;
+};
+
+inline strings_dataset_t generate_strings(std::size_t count, strings_distribution_t distribution,
+                                          std::uint64_t seed = 42) {
+    constexpr char alphanumeric[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    constexpr char path_alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789-_";
+    constexpr char const *top_level_domains[] = {".com", ".org", ".net", ".io", ".dev", ".co.uk", ".de", ".ru"};
+    constexpr std::size_t domains_count = 4096;
+
+    strings_dataset_t dataset;
+    std::vector<std::size_t> ends(count);
+    std::string &arena = dataset.arena;
+    for (std::size_t i = 0; i != count; ++i) {
+        std::uint64_t random = splitmix64(seed ^ splitmix64(i));
+        auto next = [&random]() noexcept { return random = splitmix64(random); };
+
+        if (distribution == strings_urls_k) {
+            arena += next() % 8 ? "https://" : "http://";
+            if (next() % 2)
+                arena += "www.";
+            // Popular domains repeat a lot, just like in real web crawls.
+            double const uniform = static_cast<double>(next() >> 11) * 0x1.0p-53;
+            std::uint64_t domain = splitmix64(static_cast<std::uint64_t>(std::pow(domains_count, uniform)));
+            std::size_t const domain_length = 4 + domain % 9;
+            for (std::size_t j = 0; j != domain_length; ++j, domain /= 26)
+                arena += static_cast<char>('a' + domain % 26);
+            arena += top_level_domains[domain % 8];
+            std::size_t const segments = 1 + next() % 4;
+            for (std::size_t segment = 0; segment != segments; ++segment) {
+                arena += '/';
+                std::size_t const segment_length = 2 + next() % 9;
+                for (std::size_t j = 0; j != segment_length; ++j)
+                    arena += path_alphabet[next() % 38];
+            }
+            if (next() % 4 == 0)
+                arena += "?id=" + std::to_string(next() % 1000000);
+        } else {
+            std::size_t const length = 8 + next() % 9;
+            for (std::size_t j = 0; j != length; ++j)
+                arena += alphanumeric[next() % 62];
+        }
+        ends[i] = arena.size();
+    }
+
+    // Views can only be taken once the arena stops reallocating.
+    dataset.strings.resize(count);
+    for (std::size_t i = 0, begin = 0; i != count; begin = ends[i], ++i)
+        dataset.strings[i] = std::string_view(arena.data() + begin, ends[i] - begin);
+    return dataset;
+}
+
+/// The baseline: `std::string_view::operator<` is a `std::memcmp` of the common length, like `std::strcmp`.
+struct strings_std_sort_t {
+    void operator()(std::string_view *begin, std::string_view *end) const { std::sort(begin, end); }
+};
+
+/// Returns the byte at `depth` shifted by one, or zero past the end, so that shorter strings sort first.
+inline int string_byte_at(std::string_view string, std::size_t depth) noexcept {
+    return depth < string.size() ? 1 + static_cast<unsigned char>(string[depth]) : 0;
+}
+
+/// Sorts a few strings, that all share the first `depth` bytes, without comparing those again.
+inline void strings_insertion_sort(std::string_view *begin, std::string_view *end, std::size_t depth) noexcept {
+    for (std::string_view *i = begin + 1; i < end; ++i) {
+        std::string_view const key = *i;
+        std::string_view const key_suffix = key.substr(depth);
+        std::string_view *j = i;
+        for (; j != begin && key_suffix < j[-1].substr(depth); --j)
+            *j = j[-1];
+        *j = key;
+    }
+}
+
+/// @brief  Bentley-Sedgewick multikey quicksort: a 3-way quicksort on one byte at a time,
+///         that only moves to the next byte for the strings equal to the pivot in the current one.
+struct strings_multikey_quick_sort_t {
+    static constexpr std::ptrdiff_t insertion_threshold_k = 16;
+
+    void operator()(std::string_view *begin, std::string_view *end) const noexcept { sort_(begin, end, 0); }
+
+  private:
+    static void sort_(std::string_view *begin, std::string_view *end, std::size_t depth) noexcept {
+        while (end - begin > insertion_threshold_k) {
+            int const first = string_byte_at(begin[0], depth);
+            int const middle = string_byte_at(begin[(end - begin) / 2], depth);
+            int const last = string_byte_at(end[-1], depth);
+            int const pivot = std::max(std::min(first, middle), std::min(std::max(first, middle), last));
+
+            // Dijkstra's partition: `[begin, less)` is below the pivot, `[less, i)` is equal, `[greater, end)` above.
+            std::string_view *less = begin, *i = begin, *greater = end;
+            while (i < greater) {
+                int const byte = string_byte_at(*i, depth);
+                if (byte < pivot)
+                    std::swap(*less++, *i++);
+                else if (byte > pivot)
+                    std::swap(*i, *--greater);
+                else
+                    ++i;
+            }
+            sort_(begin, less, depth);
+            sort_(greater, end, depth);
+            // Strings that ended at this depth are all equal, the others continue with the next byte.
+            if (pivot == 0)
+                return;
+            begin = less, end = greater, ++depth;
+        }
+        strings_insertion_sort(begin, end, depth);
+    }
+};
+
+/// @brief  Most-significant-digit radix sort on bytes, with 256 buckets and one more for the ended strings.
+///         The bucket of every string is read once per level into an "oracle" array, so the scatter pass
+///         doesn't have to chase the pointers again. https://arxiv.org/abs/0801.3380
+struct strings_msd_radix_sort_t {
+    static constexpr std::ptrdiff_t insertion_threshold_k = 32;
+
+    void operator()(std::string_view *begin, std::string_view *end) {
+        buffer_.resize(static_cast<std::size_t>(end - begin));
+        oracle_.resize(static_cast<std::size_t>(end - begin));
+        sort_(begin, end, buffer_.data(), oracle_.data(), 0);
+    }
+
+  private:
+    std::vector<std::string_view> buffer_;
+    std::vector<std::uint16_t> oracle_;
+
+    static void sort_(std::string_view *begin, std::string_view *end, std::string_view *buffer, std::uint16_t *oracle,
+                      std::size_t depth) noexcept {
+        for (;;) {
+            std::size_t const count = static_cast<std::size_t>(end - begin);
+            if (end - begin <= insertion_threshold_k)
+                return strings_insertion_sort(begin, end, depth);
+
+            std::array<std::size_t, 257> counts{};
+            for (std::size_t i = 0; i != count; ++i) {
+                oracle[i] = static_cast<std::uint16_t>(string_byte_at(begin[i], depth));
+                ++counts[oracle[i]];
+            }
+            // When all strings share the next byte, like "https://", skip it without moving anything.
+            if (counts[oracle[0]] == count) {
+                if (oracle[0] == 0)
+                    return;
+                ++depth;
+                continue;
+            }
+
+            std::array<std::size_t, 257> offsets;
+            std::exclusive_scan(counts.begin(), counts.end(), offsets.begin(), std::size_t(0));
+            for (std::size_t i = 0; i != count; ++i)
+                buffer[offsets[oracle[i]]++] = begin[i];
+            std::copy(buffer, buffer + count, begin);
+
+            // The first bucket holds the strings that ended, and those are all equal.
+            for (std::size_t bucket = 1, bucket_begin = counts[0]; bucket != 257; bucket_begin += counts[bucket++])
+                if (counts[bucket] > 1)
+                    sort_(begin + bucket_begin, begin + bucket_begin + counts[bucket], buffer + bucket_begin,
+                          oracle + bucket_begin, depth + 1);
+            return;
+        }
+    }
+};
+
+/// Packs the first 8 bytes of a string into an integer, that compares like the bytes, padding with zeros.
+inline std::uint64_t string_prefix(std::string_view string) noexcept {
+    std::uint64_t prefix = 0;
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::memcpy(&prefix, string.data(), std::min<std::size_t>(string.size(), 8));
+    prefix = __builtin_bswap64(prefix);
+#else
+    for (std::size_t i = 0; i != std::min<std::size_t>(string.size(), 8); ++i)
+        prefix |= std::uint64_t(static_cast<unsigned char>(string[i])) << (56 - 8 * i);
+#endif
+    return prefix;
+}
+
+/// @brief  Caches a big-endian 8-byte prefix next to every pointer, so that most comparisons resolve
+///         on integers inside the array. Only the ties have to dereference the strings.
+struct strings_prefix_cached_sort_t {
+    struct prefixed_t {
+        std::uint64_t prefix;
+        std::string_view string;
+    };
+
+    void operator()(std::string_view *begin, std::string_view *end) {
+        prefixed_.resize(static_cast<std::size_t>(end - begin));
+        std::transform(begin, end, prefixed_.begin(), [](std::string_view string) {
+            return prefixed_t{string_prefix(string), string};
+        });
+        std::sort(prefixed_.begin(), prefixed_.end(), [](prefixed_t const &a, prefixed_t const &b) noexcept {
+            if (a.prefix != b.prefix)
+                return a.prefix < b.prefix;
+            // Equal prefixes mean the first `min(8, length)` bytes are equal, so we only compare what follows.
+            std::size_t const skip = std::min({a.string.size(), b.string.size(), std::size_t(8)});
+            return a.string.substr(skip) < b.string.substr(skip);
+        });
+        std::transform(prefixed_.begin(), prefixed_.end(), begin, [](prefixed_t const &p) { return p.string; });
+    }
+
+  private:
+    std::vector<prefixed_t> prefixed_;
+};
+
+/// Reports the time and the cache misses of the sort alone, per string, excluding the copies of the input.
+inline void report_per_string(bm::State &state, std::size_t count, double sort_seconds,
+                              perf_counter_t const &cache_misses) {
+    double const strings = static_cast<double>(count) * state.iterations();
+    state.SetItemsProcessed(static_cast<std::int64_t>(strings));
+    state.counters["ns_per_string"] = sort_seconds * 1e9 / strings;
+    if (cache_misses)
+        state.counters["cache_misses_per_string"] = cache_misses.value() / strings;
+}
+
+template <typename sorter_at> static void sorting_strings(bm::State &state) {
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto distribution = static_cast<strings_distribution_t>(state.range(1));
+    strings_dataset_t const dataset = generate_strings(count, distribution);
+    std::vector<std::string_view> array(count);
+    state.SetLabel(strings_distribution_name(distribution));
+    sorter_at sorter;
+
+    perf_counter_t cache_misses(perf_cache_misses_k);
+    double sort_seconds = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::copy(dataset.strings.begin(), dataset.strings.end(), array.begin());
+        state.ResumeTiming();
+        auto start = std::chrono::steady_clock::now();
+        cache_misses.start();
+        sorter(array.data(), array.data() + count);
+        cache_misses.stop();
+        sort_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bm::DoNotOptimize(array.data());
+    }
+    if (!std::is_sorted(array.begin(), array.end()))
+        return state.SkipWithError("The strings are not sorted");
+    report_per_string(state, count, sort_seconds, cache_misses);
+}
+
+/// Sorting owning `std::string` objects also moves them around, and long ones live on the heap anyway.
+static void sorting_std_strings(bm::State &state) {
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto distribution = static_cast<strings_distribution_t>(state.range(1));
+    std::vector<std::string> original;
+    {
+        strings_dataset_t const dataset = generate_strings(count, distribution);
+        original.assign(dataset.strings.begin(), dataset.strings.end());
+    }
+    std::vector<std::string> array(count);
+    state.SetLabel(strings_distribution_name(distribution));
+
+    perf_counter_t cache_misses(perf_cache_misses_k);
+    double sort_seconds = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::copy(original.begin(), original.end(), array.begin());
+        state.ResumeTiming();
+        auto start = std::chrono::steady_clock::now();
+        cache_misses.start();
+        std::sort(array.begin(), array.end());
+        cache_misses.stop();
+        sort_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        bm::DoNotOptimize(array.data());
+    }
+    report_per_string(state, count, sort_seconds, cache_misses);
+}
+
+static void sorting_strings_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgsProduct({{1'000'000, 10'000'000, 100'000'000}, {strings_urls_k, strings_short_ids_k}})
+        ->Unit(bm::kMillisecond);
+}
+
+// With 100M URLs the arena alone takes ~4 GB, so the largest runs need a machine with ~16 GB of RAM.
+// URLs are the hard case: every one starts with "http", so the 8-byte prefixes almost never settle the order,
+// and the prefix cache ends up slower than plain `std::sort`, as it also moves 24-byte entries around.
+// The radix sort skips the shared bytes in one pass each, and is 2x faster than `std::sort` on URLs.
+// On short IDs the first 8 random bytes are practically unique, so the prefix cache sorts plain integers,
+// but the radix sort still wins, finishing most buckets within the first 3 bytes.
+BENCHMARK(sorting_std_strings)->Apply(sorting_strings_arguments);
+BENCHMARK_TEMPLATE(sorting_strings, strings_std_sort_t)->Apply(sorting_strings_arguments);
+BENCHMARK_TEMPLATE(sorting_strings, strings_multikey_quick_sort_t)->Apply(sorting_strings_arguments);
+BENCHMARK_TEMPLATE(sorting_strings, strings_msd_radix_sort_t)->Apply(sorting_strings_arguments);
+BENCHMARK_TEMPLATE(sorting_strings, strings_prefix_cached_sort_t)->Apply(sorting_strings_arguments);
+
+// ------------------------------------
+// ## Parallel Reductions
+// ------------------------------------
+//
+// A reduction folds an array into a single value: a sum, an extremum, or a dot product.
+// With just one cheap operation per loaded element, large reductions are bound by memory bandwidth,
+// and the real question is how close every implementation gets to it. In the caches the bottleneck moves
+// to the dependency chain: compilers may not reorder IEEE-754 additions without `-ffast-math`,
+// so a naive floating-point sum waits ~4 cycles for every addition, while integer sums get vectorized.
+//
+// Every reduction below defines its `identity`, the `step` folding in one more element,
+// and the `combine` that merges two partial results in any order, so that all the backends can share them.
+// The vectorized ones also define the same three operations on whole registers.
+// For the roofline, each one also declares the number of `operations_k` it performs per element.
+
+/// Horizontal reductions of a register, spilling it to the stack. They run once per call, so simplicity wins.
+template <typename lanes_at> typename lanes_at::scalar_t horizontal_sum(typename lanes_at::register_t lanes) noexcept {
+    typename lanes_at::scalar_t scalars[lanes_at::count_k];
+    lanes_at::store(scalars, lanes);
+    return std::accumulate(scalars + 1, scalars + lanes_at::count_k, scalars[0]);
+}
+template <typename lanes_at> typename lanes_at::scalar_t horizontal_min(typename lanes_at::register_t lanes) noexcept {
+    typename lanes_at::scalar_t scalars[lanes_at::count_k];
+    lanes_at::store(scalars, lanes);
+    return *std::min_element(scalars, scalars + lanes_at::count_k);
+}
+template <typename lanes_at> typename lanes_at::scalar_t horizontal_max(typename lanes_at::register_t lanes) noexcept {
+    typename lanes_at::scalar_t scalars[lanes_at::count_k];
+    lanes_at::store(scalars, lanes);
+    return *std::max_element(scalars, scalars + lanes_at::count_k);
+}
+
+/// @brief  The naive loop: a single accumulator, where every `step` waits for the previous one.
+template <typename reduction_at>
+typename reduction_at::result_t reduce_serial(typename reduction_at::scalar_t const *a,
+                                              typename reduction_at::scalar_t const *b, std::size_t begin,
+                                              std::size_t end) noexcept {
+    typename reduction_at::result_t result = reduction_at::identity();
+    for (std::size_t i = begin; i != end; ++i)
+        result = reduction_at::step(result, a, b, i);
+    return result;
+}
+
+/// @brief  Independent accumulators break the dependency chain, so the CPU keeps several `step`s in flight.
+template <typename reduction_at, std::size_t accumulators_ak = 8>
+typename reduction_at::result_t reduce_unrolled(typename reduction_at::scalar_t const *a,
+                                                typename reduction_at::scalar_t const *b, std::size_t begin,
+                                                std::size_t end) noexcept {
+    typename reduction_at::result_t results[accumulators_ak];
+    std::fill(results, results + accumulators_ak, reduction_at::identity());
+    std::size_t i = begin;
+    for (; i + accumulators_ak <= end; i += accumulators_ak)
+        for (std::size_t k = 0; k != accumulators_ak; ++k)
+            results[k] = reduction_at::step(results[k], a, b, i + k);
+    for (; i != end; ++i)
+        results[0] = reduction_at::step(results[0], a, b, i);
+    for (std::size_t k = 1; k != accumulators_ak; ++k)
+        results[0] = reduction_at::combine(results[0], results[k]);
+    return results[0];
+}
+
+/// @brief  The same idea with SIMD registers: every accumulator holds a register, and every step loads one.
+/// @tparam lanes_at    One of the `reduction_*_lanes_gt` wrappers below, defining the register operations.
+template <typename reduction_at, typename lanes_at, std::size_t accumulators_ak = 4>
+typename reduction_at::result_t reduce_simd(typename reduction_at::scalar_t const *a,
+                                            typename reduction_at::scalar_t const *b, std::size_t begin,
+                                            std::size_t end) noexcept {
+    using state_t = decltype(reduction_at::template vector_identity<lanes_at>());
+    constexpr std::size_t lanes_k = lanes_at::count_k;
+    state_t states[accumulators_ak];
+    for (state_t &state : states)
+        state = reduction_at::template vector_identity<lanes_at>();
+    std::size_t i = begin;
+    for (; i + lanes_k * accumulators_ak <= end; i += lanes_k * accumulators_ak)
+        for (std::size_t k = 0; k != accumulators_ak; ++k)
+            states[k] = reduction_at::template vector_step<lanes_at>(states[k], a, b, i + k * lanes_k);
+    for (; i + lanes_k <= end; i += lanes_k)
+        states[0] = reduction_at::template vector_step<lanes_at>(states[0], a, b, i);
+    typename reduction_at::result_t result = reduction_at::template vector_result<lanes_at>(states[0]);
+    for (std::size_t k = 1; k != accumulators_ak; ++k)
+        result = reduction_at::combine(result, reduction_at::template vector_result<lanes_at>(states[k]));
+    for (; i != end; ++i)
+        result = reduction_at::step(result, a, b, i);
+    return result;
+}
+
+template <typename scalar_at> struct sum_gt {
+    using scalar_t = scalar_at;
+    using result_t = scalar_at;
+    static constexpr std::size_t inputs_k = 1;
+    static constexpr std::size_t operations_k = 1;
+
+    static result_t identity() noexcept { return 0; }
+    static result_t step(result_t result, scalar_t const *a, scalar_t const *, std::size_t i) noexcept {
+        return result + a[i];
+    }
+    static result_t combine(result_t x, result_t y) noexcept { return x + y; }
+    template <typename policy_at>
+    static result_t standard(policy_at &&policy, scalar_t const *a, scalar_t const *, std::size_t count) {
+        return std::reduce(policy, a, a + count, identity());
+    }
+
+    template <typename lanes_at> static typename lanes_at::register_t vector_identity() noexcept {
+        return lanes_at::splat(0);
+    }
+    template <typename lanes_at>
+    static typename lanes_at::register_t vector_step(typename lanes_at::register_t state, scalar_t const *a,
+                                                     scalar_t const *, std::size_t i) noexcept {
+        return lanes_at::add(state, lanes_at::load(a + i));
+    }
+    template <typename lanes_at> static result_t vector_result(typename lanes_at::register_t state) noexcept {
+        return horizontal_sum<lanes_at>(state);
+    }
+    template <typename lanes_at>
+    static result_t simd(scalar_t const *a, scalar_t const *b, std::size_t begin, std::size_t end) noexcept {
+        return reduce_simd<sum_gt, lanes_at>(a, b, begin, end);
+    }
+};
+
+template <typename scalar_at> struct dot_gt {
+    using scalar_t = scalar_at;
+    using result_t = scalar_at;
+    static constexpr std::size_t inputs_k = 2;
+    static constexpr std::size_t operations_k = 2;
+
+    static result_t identity() noexcept { return 0; }
+    static result_t step(result_t result, scalar_t const *a, scalar_t const *b, std::size_t i) noexcept {
+        return result + a[i] * b[i];
+    }
+    static result_t combine(result_t x, result_t y) noexcept { return x + y; }
+    template <typename policy_at>
+    static result_t standard(policy_at &&policy, scalar_t const *a, scalar_t const *b, std::size_t count) {
+        return std::transform_reduce(policy, a, a + count, b, identity());
+    }
+
+    template <typename lanes_at> static typename lanes_at::register_t vector_identity() noexcept {
+        return lanes_at::splat(0);
+    }
+    template <typename lanes_at>
+    static typename lanes_at::register_t vector_step(typename lanes_at::register_t state, scalar_t const *a,
+                                                     scalar_t const *b, std::size_t i) noexcept {
+        return lanes_at::mul_add(lanes_at::load(a + i), lanes_at::load(b + i), state);
+    }
+    template <typename lanes_at> static result_t vector_result(typename lanes_at::register_t state) noexcept {
+        return horizontal_sum<lanes_at>(state);
+    }
+    template <typename lanes_at>
+    static result_t simd(scalar_t const *a, scalar_t const *b, std::size_t begin, std::size_t end) noexcept {
+        return reduce_simd<dot_gt, lanes_at>(a, b, begin, end);
+    }
+};
+
+/// The smallest element alone. Isn't benchmarked separately, but drives the vectorized `argmin_gt`.
+template <typename scalar_at> struct min_gt {
+    using scalar_t = scalar_at;
+    using result_t = scalar_at;
+    static constexpr std::size_t inputs_k = 1;
+    static constexpr std::size_t operations_k = 1;
+
+    static result_t identity() noexcept { return std::numeric_limits<scalar_t>::max(); }
+    static result_t step(result_t result, scalar_t const *a, scalar_t const *, std::size_t i) noexcept {
+        return std::min(result, a[i]);
+    }
+    static result_t combine(result_t x, result_t y) noexcept { return std::min(x, y); }
+
+    template <typename lanes_at> static typename lanes_at::register_t vector_identity() noexcept {
+        return lanes_at::splat(identity());
+    }
+    template <typename lanes_at>
+    static typename lanes_at::register_t vector_step(typename lanes_at::register_t state, scalar_t const *a,
+                                                     scalar_t const *, std::size_t i) noexcept {
+        return lanes_at::min(state, lanes_at::load(a + i));
+    }
+    template <typename lanes_at> static result_t vector_result(typename lanes_at::register_t state) noexcept {
+        return horizontal_min<lanes_at>(state);
+    }
+};
+
+/// Pairs of registers with the running minimums and maximums. A `std::pair` of intrinsic types
+/// would drop their alignment attributes, and GCC warns about that.
+template <typename lanes_at> struct minmax_registers_gt { typename lanes_at::register_t min, max; };
+
+template <typename scalar_at> struct minmax_gt {
+    using scalar_t = scalar_at;
+    using result_t = std::pair<scalar_t, scalar_t>;
+    static constexpr std::size_t inputs_k = 1;
+    static constexpr std::size_t operations_k = 2;
+
+    static result_t identity() noexcept {
+        return {std::numeric_limits<scalar_t>::max(), std::numeric_limits<scalar_t>::lowest()};
+    }
+    static result_t step(result_t result, scalar_t const *a, scalar_t const *, std::size_t i) noexcept {
+        return {std::min(result.first, a[i]), std::max(result.second, a[i])};
+    }
+    static result_t combine(result_t x, result_t y) noexcept {
+        return {std::min(x.first, y.first), std::max(x.second, y.second)};
+    }
+    template <typename policy_at>
+    static result_t standard(policy_at &&policy, scalar_t const *a, scalar_t const *, std::size_t count) {
+        return std::transform_reduce(policy, a, a + count, identity(), &combine, [](scalar_t x) noexcept {
+            return result_t{x, x};
+        });
+    }
+
+    template <typename lanes_at> static minmax_registers_gt<lanes_at> vector_identity() noexcept {
+        return {lanes_at::splat(identity().first), lanes_at::splat(identity().second)};
+    }
+    template <typename lanes_at>
+    static minmax_registers_gt<lanes_at> vector_step(minmax_registers_gt<lanes_at> state, scalar_t const *a,
+                                                     scalar_t const *, std::size_t i) noexcept {
+        auto const values = lanes_at::load(a + i);
+        return {lanes_at::min(state.min, values), lanes_at::max(state.max, values)};
+    }
+    template <typename lanes_at> static result_t vector_result(minmax_registers_gt<lanes_at> state) noexcept {
+        return {horizontal_min<lanes_at>(state.min), horizontal_max<lanes_at>(state.max)};
+    }
+    template <typename lanes_at>
+    static result_t simd(scalar_t const *a, scalar_t const *b, std::size_t begin, std::size_t end) noexcept {
+        return reduce_simd<minmax_gt, lanes_at>(a, b, begin, end);
+    }
+};
+
+/// @brief  Random-access iterator over the indices themselves, like `std::views::iota`, but usable with the
+///         parallel algorithms of C++17. Dereferencing yields the index by value.
+class index_iterator_t {
+  public:
+    using value_type = std::size_t;
+    using pointer = std::size_t const *;
+    using reference = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    explicit index_iterator_t(std::size_t index = 0) noexcept : index_(index) {}
+
+    std::size_t operator*() const noexcept { return index_; }
+    std::size_t operator[](difference_type offset) const noexcept { return index_ + offset; }
+
+    index_iterator_t &operator++() noexcept { return *this += 1; }
+    index_iterator_t &operator--() noexcept { return *this -= 1; }
+    index_iterator_t operator++(int) noexcept { return index_iterator_t(index_++); }
+    index_iterator_t operator--(int) noexcept { return index_iterator_t(index_--); }
+    index_iterator_t &operator+=(difference_type offset) noexcept {
+        index_ += offset;
+        return *this;
+    }
+    index_iterator_t &operator-=(difference_type offset) noexcept {
+        index_ -= offset;
+        return *this;
+    }
+    index_iterator_t operator+(difference_type offset) const noexcept { return index_iterator_t(index_ + offset); }
+    index_iterator_t operator-(difference_type offset) const noexcept { return index_iterator_t(index_ - offset); }
+    friend index_iterator_t operator+(difference_type offset, index_iterator_t it) noexcept { return it + offset; }
+    difference_type operator-(index_iterator_t other) const noexcept {
+        return static_cast<difference_type>(index_ - other.index_);
+    }
+
+    bool operator==(index_iterator_t other) const noexcept { return index_ == other.index_; }
+    bool operator!=(index_iterator_t other) const noexcept { return index_ != other.index_; }
+    bool operator<(index_iterator_t other) const noexcept { return index_ < other.index_; }
+    bool operator>(index_iterator_t other) const noexcept { return index_ > other.index_; }
+    bool operator<=(index_iterator_t other) const noexcept { return index_ <= other.index_; }
+    bool operator>=(index_iterator_t other) const noexcept { return index_ >= other.index_; }
+
+  private:
+    std::size_t index_ = 0;
+};
+
+/// Result of the `argmin_gt` reduction: the smallest value, and the first position it appears at.
+template <typename scalar_at> struct argmin_result_gt {
+    scalar_at value;
+    std::size_t index;
+};
+
+template <typename scalar_at> struct argmin_gt {
+    using scalar_t = scalar_at;
+    using result_t = argmin_result_gt<scalar_t>;
+    static constexpr std::size_t inputs_k = 1;
+    static constexpr std::size_t operations_k = 1;
+
+    static result_t identity() noexcept { return {std::numeric_limits<scalar_t>::max(), SIZE_MAX}; }
+    static result_t step(result_t result, scalar_t const *a, scalar_t const *, std::size_t i) noexcept {
+        return a[i] < result.value ? result_t{a[i], i} : result;
+    }
+    /// Breaking the ties by position keeps the result deterministic, whatever the order of the partial results.
+    static result_t combine(result_t x, result_t y) noexcept {
+        return y.value < x.value || (y.value == x.value && y.index < x.index) ? y : x;
+    }
+    /// Parallel policies may pass copies of trivially copyable elements, so their addresses can't be trusted
+    /// to recover the positions. Instead, we reduce over the indices themselves, and load the values by index.
+    template <typename policy_at>
+    static result_t standard(policy_at &&policy, scalar_t const *a, scalar_t const *, std::size_t count) {
+        return std::transform_reduce(policy, index_iterator_t(0), index_iterator_t(count), identity(), &combine,
+                                     [a](std::size_t i) noexcept {
+                                         return result_t{a[i], i};
+                                     });
+    }
+
+    /// Tracking the indices in registers doubles the work and limits the 32-bit lanes to 4 billion elements.
+    /// Instead, we vectorize the minimum of every 4 KB block, and only rescan the block with scalars
+    /// if it beats the best minimum so far. On most inputs those rescans quickly become rare.
+    template <typename lanes_at>
+    static result_t simd(scalar_t const *a, scalar_t const *b, std::size_t begin, std::size_t end) noexcept {
+        constexpr std::size_t block_k = 4096 / sizeof(scalar_t);
+        result_t result = identity();
+        for (std::size_t block_begin = begin; block_begin < end; block_begin += block_k) {
+            std::size_t const block_end = std::min(block_begin + block_k, end);
+            scalar_t const block_min = reduce_simd<min_gt<scalar_t>, lanes_at>(a, b, block_begin, block_end);
+            if (!(block_min < result.value))
+                continue;
+            result = {block_min, static_cast<std::size_t>(std::find(a + block_begin, a + block_end, block_min) - a)};
+        }
+        return result;
+    }
+};
+
+#if defined(__AVX2__) && defined(__FMA__)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2", "fma")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#endif
+
+template <typename scalar_at> struct reduction_avx2_lanes_gt;
+
+template <> struct reduction_avx2_lanes_gt<std::int32_t> {
+    using scalar_t = std::int32_t;
+    using register_t = __m256i;
+    static constexpr std::size_t count_k = 8;
+    static register_t load(std::int32_t const *data) noexcept {
+        return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data));
+    }
+    static void store(std::int32_t *data, register_t lanes) noexcept {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), lanes);
+    }
+    static register_t splat(std::int32_t value) noexcept { return _mm256_set1_epi32(value); }
+    static register_t add(register_t x, register_t y) noexcept { return _mm256_add_epi32(x, y); }
+    static register_t mul_add(register_t x, register_t y, register_t z) noexcept {
+        return _mm256_add_epi32(z, _mm256_mullo_epi32(x, y));
+    }
+    static register_t min(register_t x, register_t y) noexcept { return _mm256_min_epi32(x, y); }
+    static register_t max(register_t x, register_t y) noexcept { return _mm256_max_epi32(x, y); }
+};
+
+template <> struct reduction_avx2_lanes_gt<float> {
+    using scalar_t = float;
+    using register_t = __m256;
+    static constexpr std::size_t count_k = 8;
+    static register_t load(float const *data) noexcept { return _mm256_loadu_ps(data); }
+    static void store(float *data, register_t lanes) noexcept { _mm256_storeu_ps(data, lanes); }
+    static register_t splat(float value) noexcept { return _mm256_set1_ps(value); }
+    static register_t add(register_t x, register_t y) noexcept { return _mm256_add_ps(x, y); }
+    static register_t mul_add(register_t x, register_t y, register_t z) noexcept { return _mm256_fmadd_ps(x, y, z); }
+    static register_t min(register_t x, register_t y) noexcept { return _mm256_min_ps(x, y); }
+    static register_t max(register_t x, register_t y) noexcept { return _mm256_max_ps(x, y); }
+};
+
+template <> struct reduction_avx2_lanes_gt<double> {
+    using scalar_t = double;
+    using register_t = __m256d;
+    static constexpr std::size_t count_k = 4;
+    static register_t load(double const *data) noexcept { return _mm256_loadu_pd(data); }
+    static void store(double *data, register_t lanes) noexcept { _mm256_storeu_pd(data, lanes); }
+    static register_t splat(double value) noexcept { return _mm256_set1_pd(value); }
+    static register_t add(register_t x, register_t y) noexcept { return _mm256_add_pd(x, y); }
+    static register_t mul_add(register_t x, register_t y, register_t z) noexcept { return _mm256_fmadd_pd(x, y, z); }
+    static register_t min(register_t x, register_t y) noexcept { return _mm256_min_pd(x, y); }
+    static register_t max(register_t x, register_t y) noexcept { return _mm256_max_pd(x, y); }
+};
+
+/// AVX2 has neither 64-bit integer multiplications, nor 64-bit integer minimums and maximums.
+/// The products are assembled from 32-bit halves, and the extremums are blended after a comparison.
+template <> struct reduction_avx2_lanes_gt<std::int64_t> {
+    using scalar_t = std::int64_t;
+    using register_t = __m256i;
+    static constexpr std::size_t count_k = 4;
+    static register_t load(std::int64_t const *data) noexcept {
+        return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data));
+    }
+    static void store(std::int64_t *data, register_t lanes) noexcept {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), lanes);
+    }
+    static register_t splat(std::int64_t value) noexcept { return _mm256_set1_epi64x(value); }
+    static register_t add(register_t x, register_t y) noexcept { return _mm256_add_epi64(x, y); }
+    static register_t mul_add(register_t x, register_t y, register_t z) noexcept {
+        __m256i const low = _mm256_mul_epu32(x, y);
+        __m256i const cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), y),
+                                               _mm256_mul_epu32(x, _mm256_srli_epi64(y, 32)));
+        return _mm256_add_epi64(z, _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32)));
+    }
+    static register_t min(register_t x, register_t y) noexcept {
+        return _mm256_blendv_epi8(x, y, _mm256_cmpgt_epi64(x, y));
+    }
+    static register_t max(register_t x, register_t y) noexcept {
+        return _mm256_blendv_epi8(y, x, _mm256_cmpgt_epi64(x, y));
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif // defined(__AVX2__) && defined(__FMA__)
+
+#if defined(__AVX512F__)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2", "avx512f")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,avx512f"))), apply_to = function)
+#endif
+
+/// The extremums use the zero-masking forms with full masks. Those are the same instructions, but the plain
+/// intrinsics pass an "undefined" register through, and GCC 12 warns about it being uninitialized.
+template <typename scalar_at> struct reduction_avx512_lanes_gt;
+
+template <> struct reduction_avx512_lanes_gt<std::int32_t> {
+    using scalar_t = std::int32_t;
+    using register_t = __m512i;
+    static constexpr std::size_t count_k = 16;
+    static register_t load(std::int32_t const *data) noexcept { return _mm512_loadu_si512(data); }
+    static void store(std::int32_t *data, register_t lanes) noexcept { _mm512_storeu_si512(data, lanes); }
+    static register_t splat(std::int32_t value) noexcept { return _mm512_set1_epi32(value); }
+    static register_t add(register_t x, register_t y) noexcept { return _mm512_add_epi32(x, y); }
+    static register_t mul_add(register_t x, register_t y, register_t z) noexcept {
+        return _mm512_add_epi32(z, _mm512_mullo_epi32(x, y));
+    }
+    static register_t min(register_t x, register_t y) noexcept { return _mm512_maskz_min_epi32(0xFFFF, x, y); }
+    static register_t max(register_t x, register_t y) noexcept { return _mm512_maskz_max_epi32(0xFFFF, x, y); }
+};
+
+template <> struct reduction_avx512_lanes_gt<float> {
+    using scalar_t = float;
+    using register_t = __m512;
+    static constexpr std::size_t count_k = 16;
+    static register_t load(float const *data) noexcept { return _mm512_loadu_ps(data); }
+    static void store(float *data, register_t lanes) noexcept { _mm512_storeu_ps(data, lanes); }
+    static register_t splat(float value) noexcept { return _mm512_set1_ps(value); }
+    static register_t add(register_t x, register_t y) noexcept { return _mm512_add_ps(x, y); }
+    static register_t mul_add(register_t x, register_t y, register_t z) noexcept { return _mm512_fmadd_ps(x, y, z); }
+    static register_t min(register_t x, register_t y) noexcept { return _mm512_maskz_min_ps(0xFFFF, x, y); }
+    static register_t max(register_t x, register_t y) noexcept { return _mm512_maskz_max_ps(0xFFFF, x, y); }
+};
+
+template <> struct reduction_avx512_lanes_gt<double> {
+    using scalar_t = double;
+    using register_t = __m512d;
+    static constexpr std::size_t count_k = 8;
+    static register_t load(double const *data) noexcept { return _mm512_loadu_pd(data); }
+    static void store(double *data, register_t lanes) noexcept { _mm512_storeu_pd(data, lanes); }
+    static register_t splat(double value) noexcept { return _mm512_set1_pd(value); }
+    static register_t add(register_t x, register_t y) noexcept { return _mm512_add_pd(x, y); }
+    static register_t mul_add(register_t x, register_t y, register_t z) noexcept { return _mm512_fmadd_pd(x, y, z); }
+    static register_t min(register_t x, register_t y) noexcept { return _mm512_maskz_min_pd(0xFF, x, y); }
+    static register_t max(register_t x, register_t y) noexcept { return _mm512_maskz_max_pd(0xFF, x, y); }
+};
+
+/// AVX-512F has 64-bit integer extremums, but the native `vpmullq` needs AVX-512DQ.
+/// The `_mm512_mullox_epi64` intrinsic emulates it with 32-bit multiplications on any AVX-512 CPU.
+template <> struct reduction_avx512_lanes_gt<std::int64_t> {
+    using scalar_t = std::int64_t;
+    using register_t = __m512i;
+    static constexpr std::size_t count_k = 8;
+    static register_t load(std::int64_t const *data) noexcept { return _mm512_loadu_si512(data); }
+    static void store(std::int64_t *data, register_t lanes) noexcept { _mm512_storeu_si512(data, lanes); }
+    static register_t splat(std::int64_t value) noexcept { return _mm512_set1_epi64(value); }
+    static register_t add(register_t x, register_t y) noexcept { return _mm512_add_epi64(x, y); }
+    static register_t mul_add(register_t x, register_t y, register_t z) noexcept {
+        return _mm512_add_epi64(z, _mm512_mullox_epi64(x, y));
+    }
+    static register_t min(register_t x, register_t y) noexcept { return _mm512_maskz_min_epi64(0xFF, x, y); }
+    static register_t max(register_t x, register_t y) noexcept { return _mm512_maskz_max_epi64(0xFF, x, y); }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif // defined(__AVX512F__)
+
+/// The fastest single-threaded kernel available, that the multi-threaded backends run on every block.
+template <typename reduction_at>
+typename reduction_at::result_t reduce_widest(typename reduction_at::scalar_t const *a,
+                                              typename reduction_at::scalar_t const *b, std::size_t begin,
+                                              std::size_t end) noexcept {
+#if defined(__AVX512F__)
+    return reduction_at::template simd<reduction_avx512_lanes_gt<typename reduction_at::scalar_t>>(a, b, begin, end);
+#elif defined(__AVX2__) && defined(__FMA__)
+    return reduction_at::template simd<reduction_avx2_lanes_gt<typename reduction_at::scalar_t>>(a, b, begin, end);
+#else
+    return reduce_unrolled<reduction_at>(a, b, begin, end);
+#endif
+}
+
+/// Blocks of 64K elements are large enough to amortize the scheduling, and small enough to balance the load.
+constexpr std::size_t reduction_block_k = 1 << 16;
+
+#if defined(_OPENMP)
+
+/// OpenMP has built-in `reduction(+ : ...)` and `reduction(min : ...)` clauses, but not for pairs or indices.
+/// A user-defined reduction covers them all, and the compiler still gives every thread a private copy.
+template <typename reduction_at>
+typename reduction_at::result_t reduce_openmp(typename reduction_at::scalar_t const *a,
+                                              typename reduction_at::scalar_t const *b, std::size_t count) noexcept {
+    using result_t = typename reduction_at::result_t;
+    result_t result = reduction_at::identity();
+    std::ptrdiff_t const blocks = static_cast<std::ptrdiff_t>((count + reduction_block_k - 1) / reduction_block_k);
+#pragma omp declare reduction(combine:result_t                                                                         \
+                              : omp_out = reduction_at::combine(omp_out, omp_in))                                      \
+    initializer(omp_priv = reduction_at::identity())
+#pragma omp parallel for schedule(static) reduction(combine : result)
+    for (std::ptrdiff_t block = 0; block < blocks; ++block) {
+        std::size_t const begin = static_cast<std::size_t>(block) * reduction_block_k;
+        result = reduction_at::combine(
+            result, reduce_widest<reduction_at>(a, b, begin, std::min(begin + reduction_block_k, count)));
+    }
+    return result;
+}
+
+#endif // defined(_OPENMP)
+
+#if defined(TUTORIAL_USE_TBB)
+
+template <typename reduction_at>
+typename reduction_at::result_t reduce_tbb(typename reduction_at::scalar_t const *a,
+                                           typename reduction_at::scalar_t const *b, std::size_t count) {
+    using result_t = typename reduction_at::result_t;
+    return tbb::parallel_reduce(
+        tbb::blocked_range<std::size_t>(0, count, reduction_block_k), reduction_at::identity(),
+        [=](tbb::blocked_range<std::size_t> const &range, result_t result) noexcept {
+            return reduction_at::combine(result, reduce_widest<reduction_at>(a, b, range.begin(), range.end()));
+        },
+        &reduction_at::combine);
+}
+
+#endif // defined(TUTORIAL_USE_TBB)
+
+enum reduction_backend_t {
+    reduction_serial_k,
+    reduction_unrolled_k,
+    reduction_avx2_k,
+    reduction_avx512_k,
+    reduction_std_seq_k,
+    reduction_std_unseq_k,
+    reduction_std_par_k,
+    reduction_std_par_unseq_k,
+    reduction_openmp_k,
+    reduction_tbb_k,
+    reduction_backends_count_k,
+};
+
+inline char const *reduction_backend_name(reduction_backend_t backend) noexcept {
+    switch (backend) {
+    case reduction_serial_k:
+        return "serial";
+    case reduction_unrolled_k:
+        return "unrolled";
+    case reduction_avx2_k:
+        return "avx2";
+    case reduction_avx512_k:
+        return "avx512";
+    case reduction_std_seq_k:
+        return "std::reduce/seq";
+    case reduction_std_unseq_k:
+        return "std::reduce/unseq";
+    case reduction_std_par_k:
+        return "std::reduce/par";
+    case reduction_std_par_unseq_k:
+        return "std::reduce/par_unseq";
+    case reduction_openmp_k:
+        return "openmp";
+    case reduction_tbb_k:
+        return "tbb";
+    default:
+        return "unknown";
+    }
+}
+
+/// Not every backend is compiled in everywhere, and we only register the available ones.
+inline bool reduction_backend_available(reduction_backend_t backend) noexcept {
+    switch (backend) {
+    case reduction_serial_k:
+        return true;
+    case reduction_unrolled_k:
+        return true;
+#if defined(__AVX2__) && defined(__FMA__)
+    case reduction_avx2_k:
+        return true;
+#endif
+#if defined(__AVX512F__)
+    case reduction_avx512_k:
+        return true;
+#endif
+#if defined(__cpp_lib_parallel_algorithm)
+    case reduction_std_seq_k:
+        return true;
+    case reduction_std_par_k:
+        return true;
+    case reduction_std_par_unseq_k:
+        return true;
+#endif
+#if defined(__cpp_lib_parallel_algorithm) && __cpp_lib_execution >= 201902L
+    case reduction_std_unseq_k:
+        return true;
+#endif
+#if defined(_OPENMP)
+    case reduction_openmp_k:
+        return true;
+#endif
+#if defined(TUTORIAL_USE_TBB)
+    case reduction_tbb_k:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+/// Serial loops are compared against the scalar peak, and everything the compiler may vectorize
+/// against the widest one, like the kernels that the parallel backends dispatch to.
+inline roofline_isa_t reduction_backend_isa(reduction_backend_t backend) noexcept {
+    switch (backend) {
+    case reduction_serial_k:
+        return roofline_scalar_k;
+    case reduction_unrolled_k:
+        return roofline_scalar_k;
+    case reduction_avx2_k:
+        return roofline_avx2_k;
+    case reduction_avx512_k:
+        return roofline_avx512_k;
+    case reduction_std_seq_k:
+        return roofline_scalar_k;
+    default:
+        return roofline_widest_k;
+    }
+}
+
+inline std::size_t reduction_backend_threads(reduction_backend_t backend) noexcept {
+    switch (backend) {
+    case reduction_std_par_k:
+    case reduction_std_par_unseq_k:
+    case reduction_openmp_k:
+    case reduction_tbb_k:
+        return std::max(1u, std::thread::hardware_concurrency());
+    default:
+        return 1;
+    }
+}
+
+template <typename reduction_at>
+typename reduction_at::result_t reduce_with(reduction_backend_t backend, typename reduction_at::scalar_t const *a,
+                                            typename reduction_at::scalar_t const *b, std::size_t count) {
+    switch (backend) {
+    case reduction_serial_k:
+        return reduce_serial<reduction_at>(a, b, 0, count);
+    case reduction_unrolled_k:
+        return reduce_unrolled<reduction_at>(a, b, 0, count);
+#if defined(__AVX2__) && defined(__FMA__)
+    case reduction_avx2_k:
+        return reduction_at::template simd<reduction_avx2_lanes_gt<typename reduction_at::scalar_t>>(a, b, 0, count);
+#endif
+#if defined(__AVX512F__)
+    case reduction_avx512_k:
+        return reduction_at::template simd<reduction_avx512_lanes_gt<typename reduction_at::scalar_t>>(a, b, 0, count);
+#endif
+#if defined(__cpp_lib_parallel_algorithm)
+    case reduction_std_seq_k:
+        return reduction_at::standard(std::execution::seq, a, b, count);
+    case reduction_std_par_k:
+        return reduction_at::standard(std::execution::par, a, b, count);
+    case reduction_std_par_unseq_k:
+        return reduction_at::standard(std::execution::par_unseq, a, b, count);
+#endif
+#if defined(__cpp_lib_parallel_algorithm) && __cpp_lib_execution >= 201902L
+    case reduction_std_unseq_k:
+        return reduction_at::standard(std::execution::unseq, a, b, count);
+#endif
+#if defined(_OPENMP)
+    case reduction_openmp_k:
+        return reduce_openmp<reduction_at>(a, b, count);
+#endif
+#if defined(TUTORIAL_USE_TBB)
+    case reduction_tbb_k:
+        return reduce_tbb<reduction_at>(a, b, count);
+#endif
+    default:
+        // Only the available backends are registered, so this is unreachable.
+        assert(false && "The backend isn't compiled in");
+        return reduction_at::identity();
+    }
+}
+
+/// @brief  Checks a backend against the serial loop. Floating-point sums and dot products add in different
+///         orders, so they may differ by rounding errors, that grow with the number of additions.
+///         Integers and extremums must match exactly.
+template <typename scalar_at> bool reduction_results_match(scalar_at x, scalar_at y, std::size_t count) noexcept {
+    if constexpr (std::is_floating_point<scalar_at>::value)
+        return std::abs(x - y) <= 4 * static_cast<scalar_at>(count) * std::numeric_limits<scalar_at>::epsilon();
+    else
+        return x == y;
+}
+template <typename scalar_at>
+bool reduction_results_match(std::pair<scalar_at, scalar_at> x, std::pair<scalar_at, scalar_at> y,
+                             std::size_t count) noexcept {
+    return reduction_results_match(x.first, y.first, count) && reduction_results_match(x.second, y.second, count);
+}
+template <typename scalar_at>
+bool reduction_results_match(argmin_result_gt<scalar_at> x, argmin_result_gt<scalar_at> y, std::size_t) noexcept {
+    return x.value == y.value && x.index == y.index;
+}
+
+/// The last inputs of the reduction benchmarks, shared between all the scalar types.
+struct reduction_inputs_t {
+    std::unique_ptr<std::uint64_t[]> words;
+    std::size_t count = 0;
+    std::type_info const *type = nullptr;
+};
+
+/// @brief  Returns two arrays of `count` random scalars each, back to back, or null if they don't fit in memory.
+///         Filling tens of gigabytes takes longer than reducing them, so the inputs are only regenerated
+///         when the scalar type or the size change, and the registrations keep the size as the outer loop.
+template <typename scalar_at> scalar_at *reduction_inputs(std::size_t count) {
+    static reduction_inputs_t inputs;
+    if (inputs.type == &typeid(scalar_at) && inputs.count == count)
+        return reinterpret_cast<scalar_at *>(inputs.words.get());
+
+    inputs = {};
+    std::size_t const words = (2 * count * sizeof(scalar_at) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+    if (!fits_in_memory(words * sizeof(std::uint64_t)))
+        return nullptr;
+    inputs.words.reset(new (std::nothrow) std::uint64_t[words]);
+    if (!inputs.words)
+        return nullptr;
+    inputs.count = count, inputs.type = &typeid(scalar_at);
+
+    // Small integers keep the 64-bit sums and dot products far from overflowing, even for billions of them.
+    scalar_at *scalars = reinterpret_cast<scalar_at *>(inputs.words.get());
+    for (std::size_t i = 0; i != 2 * count; ++i)
+        if (std::is_floating_point<scalar_at>::value)
+            scalars[i] = static_cast<scalar_at>(static_cast<double>(splitmix64(i) >> 11) * 0x1.0p-52 - 1);
+        else
+            scalars[i] = static_cast<scalar_at>(splitmix64(i) % 2048) - 1024;
+    return scalars;
+}
+
+template <typename reduction_at> static void reduction(bm::State &state) {
+    using scalar_t = typename reduction_at::scalar_t;
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto backend = static_cast<reduction_backend_t>(state.range(1));
+    state.SetLabel(reduction_backend_name(backend));
+
+    // Measure the ceiling first, before the inputs take over the memory.
+    double const bandwidth = memory_read_bandwidth();
+    scalar_t const *a = reduction_inputs<scalar_t>(count);
+    if (!a)
+        return state.SkipWithError("Not enough memory for the inputs");
+    scalar_t const *b = a + count;
+
+    // Before the timed runs, every backend is checked once against the serial loop, that is cached per size.
+    using result_t = typename reduction_at::result_t;
+    static std::map<std::size_t, result_t> serial_results;
+    auto serial = serial_results.find(count);
+    if (serial == serial_results.end())
+        serial = serial_results.emplace(count, reduce_serial<reduction_at>(a, b, 0, count)).first;
+    if (!reduction_results_match(reduce_with<reduction_at>(backend, a, b, count), serial->second, count))
+        return state.SkipWithError("The result differs from the serial reference");
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        result_t result = reduce_with<reduction_at>(backend, a, b, count);
+        bm::DoNotOptimize(result);
+    }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Inputs that fit in the caches are read faster than memory allows, and exceed 100% of the ceiling.
+    std::size_t const bytes = count * sizeof(scalar_t) * reduction_at::inputs_k;
+    state.SetBytesProcessed(bytes * state.iterations());
+    state.counters["bandwidth_utilization"] = static_cast<double>(bytes * state.iterations()) / seconds / bandwidth;
+
+    // The roofline, on the other hand, knows which cache level serves the inputs.
+    roofline_work_t work;
+    work.operations = static_cast<double>(count * reduction_at::operations_k), work.bytes = bytes;
+    work.working_set = bytes, work.scalar_size = sizeof(scalar_t);
+    work.isa = reduction_backend_isa(backend), work.threads = reduction_backend_threads(backend);
+    report_roofline(state, work, seconds);
+}
+
+/// From 16 KB in L1 to 16 GB per input of doubles, with the size as the outer loop.
+static void reduction_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"count", "backend"});
+    for (std::int64_t count : bm::CreateRange(1l << 12, 1l << 31, 32))
+        for (int backend = 0; backend != reduction_backends_count_k; ++backend)
+            if (reduction_backend_available(static_cast<reduction_backend_t>(backend)))
+                benchmark->Args({count, backend});
+    benchmark->UseRealTime();
+}
+
+// On 16 KB of floats, the serial sum is 20x slower than the AVX2 one, bound by the latency of additions.
+// From memory, every vectorized kernel lands within 10-25% of the ceiling, even on a single core,
+// so it takes just a few threads to saturate the memory bus, and the rest only add scheduling overhead.
+BENCHMARK_TEMPLATE(reduction, sum_gt<float>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, sum_gt<double>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, sum_gt<std::int64_t>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, minmax_gt<float>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, minmax_gt<double>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, minmax_gt<std::int64_t>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, argmin_gt<float>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, argmin_gt<double>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, argmin_gt<std::int64_t>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, dot_gt<float>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, dot_gt<double>)->Apply(reduction_arguments);
+BENCHMARK_TEMPLATE(reduction, dot_gt<std::int64_t>)->Apply(reduction_arguments);
+
+// ------------------------------------
+// ## Parallel Prefix Sums
+// ------------------------------------
+//
+// A scan replaces every element with the sum of all the elements before it. The inclusive variant counts
+// the element itself, and the exclusive one doesn't, and is exactly what a radix partitioning needs
+// to turn a histogram into the offsets of the buckets, or a compaction to find where every survivor goes.
+// Every output depends on the previous one, so a naive scan is a chain of additions, but the associativity
+// of the addition lets us scan the pieces independently, and fix them up with the sums of their predecessors.
+//
+// Within a register, the Hillis-Steele scheme takes log2(lanes) steps, adding to every lane
+// the lane `1, 2, 4, ...` positions below it. It performs more additions than a serial loop,
+// but those are whole-register additions, and the only chain between registers is a single addition
+// and a broadcast of the running total.
+
+/// @brief  Scans a slice serially, continuing from the `carry` of the previous slices.
+/// @return The `carry` plus the sum of the slice, to continue the next slice from.
+template <bool inclusive_ak, typename scalar_at>
+scalar_at scan_serial(scalar_at const *input, scalar_at *output, std::size_t count, scalar_at carry) noexcept {
+    for (std::size_t i = 0; i != count; ++i) {
+        scalar_at const value = input[i];
+        if (inclusive_ak) {
+            carry += value;
+            output[i] = carry;
+        } else {
+            output[i] = carry;
+            carry += value;
+        }
+    }
+    return carry;
+}
+
+/// @brief  Inclusive scan of a single register with the Hillis-Steele log-step scheme.
+/// @tparam lanes_at    One of the `scan_*_lanes_gt` wrappers below, that can also shift lanes up.
+template <typename lanes_at>
+typename lanes_at::register_t inclusive_scan_register(typename lanes_at::register_t lanes) noexcept {
+    lanes = lanes_at::add(lanes, lanes_at::template shift_up<1>(lanes));
+    lanes = lanes_at::add(lanes, lanes_at::template shift_up<2>(lanes));
+    if constexpr (lanes_at::count_k > 4)
+        lanes = lanes_at::add(lanes, lanes_at::template shift_up<4>(lanes));
+    if constexpr (lanes_at::count_k > 8)
+        lanes = lanes_at::add(lanes, lanes_at::template shift_up<8>(lanes));
+    return lanes;
+}
+
+/// @brief  Scans a slice a register at a time, continuing from the `carry` of the previous slices.
+///         The exclusive scan is the inclusive one shifted up by one lane, so both are exactly the same sums.
+template <typename lanes_at, bool inclusive_ak>
+typename lanes_at::scalar_t scan_simd(typename lanes_at::scalar_t const *input, typename lanes_at::scalar_t *output,
+                                      std::size_t count, typename lanes_at::scalar_t carry) noexcept {
+    using register_t = typename lanes_at::register_t;
+    constexpr std::size_t lanes_k = lanes_at::count_k;
+    register_t carries = lanes_at::splat(carry);
+    std::size_t i = 0;
+    for (; i + lanes_k <= count; i += lanes_k) {
+        register_t const sums = inclusive_scan_register<lanes_at>(lanes_at::load(input + i));
+        register_t const totals = lanes_at::add(sums, carries);
+        lanes_at::store(output + i,
+                        inclusive_ak ? totals : lanes_at::add(lanes_at::template shift_up<1>(sums), carries));
+        // Broadcasting the local sums, rather than the `totals`, keeps the permutation off the dependency chain.
+        carries = lanes_at::add(carries, lanes_at::broadcast_last(sums));
+    }
+    typename lanes_at::scalar_t scalars[lanes_k];
+    lanes_at::store(scalars, carries);
+    return scan_serial<inclusive_ak>(input + i, output + i, count - i, scalars[0]);
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2", "fma")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#endif
+
+/// AVX2 can't shift a whole register by a number of lanes: `vpslldq` only shifts within the 128-bit halves.
+/// Instead, we permute the 32-bit words across the whole register, and blend zeros into the bottom ones.
+template <int words_ak> __m256i avx2_shift_up_words(__m256i words) noexcept {
+    __m256i const indices =
+        _mm256_setr_epi32((0 - words_ak) & 7, (1 - words_ak) & 7, (2 - words_ak) & 7, (3 - words_ak) & 7,
+                          (4 - words_ak) & 7, (5 - words_ak) & 7, (6 - words_ak) & 7, (7 - words_ak) & 7);
+    return _mm256_blend_epi32(_mm256_permutevar8x32_epi32(words, indices), _mm256_setzero_si256(), (1 << words_ak) - 1);
+}
+
+template <typename scalar_at> struct scan_avx2_lanes_gt;
+
+template <> struct scan_avx2_lanes_gt<std::int32_t> : public reduction_avx2_lanes_gt<std::int32_t> {
+    template <int lanes_ak> static register_t shift_up(register_t x) noexcept {
+        return avx2_shift_up_words<lanes_ak>(x);
+    }
+    static register_t broadcast_last(register_t x) noexcept {
+        return _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+    }
+};
+
+template <> struct scan_avx2_lanes_gt<std::int64_t> : public reduction_avx2_lanes_gt<std::int64_t> {
+    template <int lanes_ak> static register_t shift_up(register_t x) noexcept {
+        return avx2_shift_up_words<lanes_ak * 2>(x);
+    }
+    static register_t broadcast_last(register_t x) noexcept { return _mm256_permute4x64_epi64(x, 0xFF); }
+};
+
+template <> struct scan_avx2_lanes_gt<float> : public reduction_avx2_lanes_gt<float> {
+    template <int lanes_ak> static register_t shift_up(register_t x) noexcept {
+        return _mm256_castsi256_ps(avx2_shift_up_words<lanes_ak>(_mm256_castps_si256(x)));
+    }
+    static register_t broadcast_last(register_t x) noexcept {
+        return _mm256_permutevar8x32_ps(x, _mm256_set1_epi32(7));
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif // defined(__AVX2__) && defined(__FMA__)
+
+#if defined(__AVX512F__)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2", "avx512f")
+#elif defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,avx512f"))), apply_to = function)
+#endif
+
+/// Unlike AVX2, `valignd` and `valignq` shift across the whole register, pulling zeros from a second one.
+/// Like in the reductions, the zero-masking forms with full masks avoid the false GCC 12 warnings.
+template <typename scalar_at> struct scan_avx512_lanes_gt;
+
+template <> struct scan_avx512_lanes_gt<std::int32_t> : public reduction_avx512_lanes_gt<std::int32_t> {
+    template <int lanes_ak> static register_t shift_up(register_t x) noexcept {
+        return _mm512_maskz_alignr_epi32(0xFFFF, x, _mm512_setzero_si512(), 16 - lanes_ak);
+    }
+    static register_t broadcast_last(register_t x) noexcept {
+        return _mm512_maskz_permutexvar_epi32(0xFFFF, _mm512_set1_epi32(15), x);
+    }
+};
+
+template <> struct scan_avx512_lanes_gt<std::int64_t> : public reduction_avx512_lanes_gt<std::int64_t> {
+    template <int lanes_ak> static register_t shift_up(register_t x) noexcept {
+        return _mm512_maskz_alignr_epi64(0xFF, x, _mm512_setzero_si512(), 8 - lanes_ak);
+    }
+    static register_t broadcast_last(register_t x) noexcept {
+        return _mm512_maskz_permutexvar_epi64(0xFF, _mm512_set1_epi64(7), x);
+    }
+};
+
+template <> struct scan_avx512_lanes_gt<float> : public reduction_avx512_lanes_gt<float> {
+    template <int lanes_ak> static register_t shift_up(register_t x) noexcept {
+        __m512i const words = _mm512_castps_si512(x);
+        return _mm512_castsi512_ps(_mm512_maskz_alignr_epi32(0xFFFF, words, _mm512_setzero_si512(), 16 - lanes_ak));
+    }
+    static register_t broadcast_last(register_t x) noexcept {
+        return _mm512_maskz_permutexvar_ps(0xFFFF, _mm512_set1_epi32(15), x);
+    }
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#elif defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif // defined(__AVX512F__)
+
+/// The fastest single-threaded scan available, that the multi-threaded ones run on every block.
+template <bool inclusive_ak, typename scalar_at>
+scalar_at scan_widest(scalar_at const *input, scalar_at *output, std::size_t count, scalar_at carry) noexcept {
+#if defined(__AVX512F__)
+    return scan_simd<scan_avx512_lanes_gt<scalar_at>, inclusive_ak>(input, output, count, carry);
+#elif defined(__AVX2__) && defined(__FMA__)
+    return scan_simd<scan_avx2_lanes_gt<scalar_at>, inclusive_ak>(input, output, count, carry);
+#else
+    return scan_serial<inclusive_ak>(input, output, count, carry);
+#endif
+}
+
+#if defined(TUTORIAL_USE_TBB)
+
+/// Blocks of 64K elements take 256-512 KB, and stay in L2 between the two reads of the look-back scan.
+constexpr std::size_t scan_block_k = 1 << 16;
+
+/// @brief  The classic parallel scan. The first pass sums every block independently, a tiny serial scan
+///         turns those sums into the offsets of the blocks, and the second pass scans every block from its offset.
+///         The input is read from memory twice, and the output written once.
+template <bool inclusive_ak, typename scalar_at>
+void scan_two_pass(scalar_at const *input, scalar_at *output, std::size_t count) {
+    std::size_t const blocks = (count + scan_block_k - 1) / scan_block_k;
+    std::vector<scalar_at> offsets(blocks);
+    tbb::parallel_for(std::size_t(0), blocks, [&](std::size_t block) {
+        std::size_t const begin = block * scan_block_k, end = std::min(begin + scan_block_k, count);
+        offsets[block] = reduce_widest<sum_gt<scalar_at>>(input, nullptr, begin, end);
+    });
+    scan_serial<false>(offsets.data(), offsets.data(), blocks, scalar_at(0));
+    tbb::parallel_for(std::size_t(0), blocks, [&](std::size_t block) {
+        std::size_t const begin = block * scan_block_k, end = std::min(begin + scan_block_k, count);
+        scan_widest<inclusive_ak>(input + begin, output + begin, end - begin, offsets[block]);
+    });
+}
+
+enum scan_tile_status_t {
+    scan_tile_empty_k,
+    scan_tile_aggregate_k,
+    scan_tile_prefix_k,
+};
+
+/// The published state of a tile in the decoupled look-back scan. The sums are written before the status,
+/// that is stored with release semantics, and every tile has its own cache line, so that spinning on one
+/// doesn't slow down the others.
+template <typename scalar_at> struct alignas(64) scan_tile_gt {
+    std::atomic<int> status{scan_tile_empty_k};
+    scalar_at aggregate{}; ///< Sum of the tile itself
+    scalar_at prefix{};    ///< Sum of the tile, and all the tiles before it
+};
+
+/// @brief  Single-pass scan with decoupled look-back, from Merrill & Garland (2016), designed for GPUs.
+///         Tiles are taken in order from an atomic counter. Every tile publishes its own sum right away,
+///         then walks back through its predecessors, adding up their sums until it finds a complete prefix.
+///         As soon as it knows its own prefix, it publishes it, so the successors rarely walk back far,
+///         and only then scans its tile, that is still in cache from the first read.
+///         https://research.nvidia.com/publication/2016-03_single-pass-parallel-prefix-scan-decoupled-look-back
+template <bool inclusive_ak, typename scalar_at>
+void scan_look_back(scalar_at const *input, scalar_at *output, std::size_t count) {
+    std::size_t const tiles = (count + scan_block_k - 1) / scan_block_k;
+    std::vector<scan_tile_gt<scalar_at>> statuses(tiles);
+    std::atomic<std::size_t> next_tile{0};
+
+    // Every tile only waits for the tiles taken before it, and their threads are already working on them,
+    // so the waits are short, and can't deadlock, however TBB schedules these loops.
+    int const threads = tbb::this_task_arena::max_concurrency();
+    tbb::parallel_for(0, threads, [&](int) {
+        for (std::size_t tile; (tile = next_tile.fetch_add(1, std::memory_order_relaxed)) < tiles;) {
+            std::size_t const begin = tile * scan_block_k, end = std::min(begin + scan_block_k, count);
+            scalar_at const aggregate = reduce_widest<sum_gt<scalar_at>>(input, nullptr, begin, end);
+            scan_tile_gt<scalar_at> &status = statuses[tile];
+            status.aggregate = aggregate;
+            status.status.store(scan_tile_aggregate_k, std::memory_order_release);
+
+            scalar_at prefix = 0;
+            for (std::size_t predecessor = tile; predecessor-- != 0;) {
+                scan_tile_gt<scalar_at> const &other = statuses[predecessor];
+                int published;
+                while ((published = other.status.load(std::memory_order_acquire)) == scan_tile_empty_k)
+                    std::this_thread::yield();
+                if (published == scan_tile_prefix_k) {
+                    prefix += other.prefix;
+                    break;
+                }
+                prefix += other.aggregate;
+            }
+            status.prefix = prefix + aggregate;
+            status.status.store(scan_tile_prefix_k, std::memory_order_release);
+            scan_widest<inclusive_ak>(input + begin, output + begin, end - begin, prefix);
+        }
+    });
+}
+
+#endif // defined(TUTORIAL_USE_TBB)
+
+enum scan_backend_t {
+    scan_serial_k,
+    scan_avx2_k,
+    scan_avx512_k,
+    scan_two_pass_k,
+    scan_look_back_k,
+    scan_std_seq_k,
+    scan_std_par_unseq_k,
+    scan_backends_count_k,
+};
+
+inline char const *scan_backend_name(scan_backend_t backend) noexcept {
+    switch (backend) {
+    case scan_serial_k:
+        return "serial";
+    case scan_avx2_k:
+        return "avx2";
+    case scan_avx512_k:
+        return "avx512";
+    case scan_two_pass_k:
+        return "two_pass";
+    case scan_look_back_k:
+        return "look_back";
+    case scan_std_seq_k:
+        return "std::seq";
+    case scan_std_par_unseq_k:
+        return "std::par_unseq";
+    default:
+        return "unknown";
+    }
+}
+
+inline bool scan_backend_available(scan_backend_t backend) noexcept {
+    switch (backend) {
+    case scan_serial_k:
+        return true;
+#if defined(__AVX2__) && defined(__FMA__)
+    case scan_avx2_k:
+        return true;
+#endif
+#if defined(__AVX512F__)
+    case scan_avx512_k:
+        return true;
+#endif
+#if defined(TUTORIAL_USE_TBB)
+    case scan_two_pass_k:
+        return true;
+    case scan_look_back_k:
+        return true;
+#endif
+#if defined(__cpp_lib_parallel_algorithm)
+    case scan_std_seq_k:
+        return true;
+    case scan_std_par_unseq_k:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+inline roofline_isa_t scan_backend_isa(scan_backend_t backend) noexcept {
+    switch (backend) {
+    case scan_serial_k:
+        return roofline_scalar_k;
+    case scan_avx2_k:
+        return roofline_avx2_k;
+    case scan_avx512_k:
+        return roofline_avx512_k;
+    case scan_std_seq_k:
+        return roofline_scalar_k;
+    default:
+        return roofline_widest_k;
+    }
+}
+
+inline std::size_t scan_backend_threads(scan_backend_t backend) noexcept {
+    switch (backend) {
+    case scan_two_pass_k:
+    case scan_look_back_k:
+    case scan_std_par_unseq_k:
+        return std::max(1u, std::thread::hardware_concurrency());
+    default:
+        return 1;
+    }
+}
+
+template <bool inclusive_ak, typename scalar_at>
+void scan_with(scan_backend_t backend, scalar_at const *input, scalar_at *output, std::size_t count) {
+    switch (backend) {
+    case scan_serial_k:
+        scan_serial<inclusive_ak>(input, output, count, scalar_at(0));
+        break;
+#if defined(__AVX2__) && defined(__FMA__)
+    case scan_avx2_k:
+        scan_simd<scan_avx2_lanes_gt<scalar_at>, inclusive_ak>(input, output, count, 0);
+        break;
+#endif
+#if defined(__AVX512F__)
+    case scan_avx512_k:
+        scan_simd<scan_avx512_lanes_gt<scalar_at>, inclusive_ak>(input, output, count, 0);
+        break;
+#endif
+#if defined(TUTORIAL_USE_TBB)
+    case scan_two_pass_k:
+        scan_two_pass<inclusive_ak>(input, output, count);
+        break;
+    case scan_look_back_k:
+        scan_look_back<inclusive_ak>(input, output, count);
+        break;
+#endif
+#if defined(__cpp_lib_parallel_algorithm)
+    case scan_std_seq_k:
+        if (inclusive_ak) {
+            std::inclusive_scan(std::execution::seq, input, input + count, output);
+        } else {
+            std::exclusive_scan(std::execution::seq, input, input + count, output, scalar_at(0));
+        }
+        break;
+    case scan_std_par_unseq_k:
+        if (inclusive_ak) {
+            std::inclusive_scan(std::execution::par_unseq, input, input + count, output);
+        } else {
+            std::exclusive_scan(std::execution::par_unseq, input, input + count, output, scalar_at(0));
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+template <typename scalar_at> static void prefix_sum(bm::State &state) {
+    auto count = static_cast<std::size_t>(state.range(0));
+    auto backend = static_cast<scan_backend_t>(state.range(1));
+    bool const inclusive = state.range(2) != 0;
+    state.SetLabel(std::string(scan_backend_name(backend)) + (inclusive ? "/inclusive" : "/exclusive"));
+
+    // Small values keep the 32-bit running sums of random walks far from overflowing.
+    std::vector<scalar_at> input(count), output(count);
+    for (std::size_t i = 0; i != count; ++i)
+        if (std::is_floating_point<scalar_at>::value)
+            input[i] = static_cast<scalar_at>(static_cast<double>(splitmix64(i) >> 11) * 0x1.0p-52 - 1);
+        else
+            input[i] = static_cast<scalar_at>(splitmix64(i) % 16) - 8;
+
+    // Before the timed runs, the output is checked once against the standard library. The parallel scans
+    // add in a different order, so floats may drift from it by rounding errors, growing along the array.
+    std::vector<scalar_at> expected(count);
+    if (inclusive) {
+        std::inclusive_scan(input.begin(), input.end(), expected.begin());
+        scan_with<true>(backend, input.data(), output.data(), count);
+    } else {
+        std::exclusive_scan(input.begin(), input.end(), expected.begin(), scalar_at(0));
+        scan_with<false>(backend, input.data(), output.data(), count);
+    }
+    for (std::size_t i = 0; i != count; ++i) {
+        bool const matches = std::is_floating_point<scalar_at>::value
+                                 ? std::abs(static_cast<double>(output[i]) - static_cast<double>(expected[i])) <=
+                                       4.0 * (i + 1) * std::numeric_limits<scalar_at>::epsilon()
+                                 : output[i] == expected[i];
+        if (!matches)
+            return state.SkipWithError("The result differs from `std::inclusive_scan` or `std::exclusive_scan`");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        if (inclusive) {
+            scan_with<true>(backend, input.data(), output.data(), count);
+        } else {
+            scan_with<false>(backend, input.data(), output.data(), count);
+        }
+        bm::DoNotOptimize(output.data());
+    }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    state.SetItemsProcessed(count * state.iterations());
+    state.SetBytesProcessed(2 * count * sizeof(scalar_at) * state.iterations());
+
+    // One addition per element, and the roof only counts the unavoidable traffic: a read and a write.
+    // The second read of the two-pass scan is the price of its algorithm, and shows up as lower utilization.
+    roofline_work_t work;
+    work.operations = static_cast<double>(count), work.bytes = 2.0 * count * sizeof(scalar_at);
+    work.working_set = 2 * count * sizeof(scalar_at), work.scalar_size = sizeof(scalar_at);
+    work.isa = scan_backend_isa(backend), work.threads = scan_backend_threads(backend);
+    report_roofline(state, work, seconds);
+}
+
+static void prefix_sum_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"count", "backend", "inclusive"});
+    for (std::int64_t count : bm::CreateRange(1l << 12, 1l << 26, 16))
+        for (int backend = 0; backend != scan_backends_count_k; ++backend)
+            if (scan_backend_available(static_cast<scan_backend_t>(backend)))
+                for (std::int64_t inclusive : {0, 1})
+                    benchmark->Args({count, backend, inclusive});
+    benchmark->UseRealTime();
+}
+
+// In L1, the AVX-512 scan of 32-bit integers is 2-3x faster than the serial one, and bound by the shuffles,
+// that all compete for the same port. Beyond the caches, every single-threaded variant converges to the
+// memory bandwidth. There, the look-back scan reads every element from memory once, and the two-pass one twice.
+BENCHMARK_TEMPLATE(prefix_sum, std::int32_t)->Apply(prefix_sum_arguments);
+BENCHMARK_TEMPLATE(prefix_sum, std::int64_t)->Apply(prefix_sum_arguments);
+BENCHMARK_TEMPLATE(prefix_sum, float)->Apply(prefix_sum_arguments);
+
+// ------------------------------------
+// ## Coroutines
+// ------------------------------------
+//
+// C++20 coroutines are functions that can suspend, keeping their locals in a "frame" that outlives the call.
+// Pipelines built from them read like plain loops, but every suspension is an indirect jump, and every frame
+// is a potential heap allocation. Compilers may elide it, when the caller provably outlives the callee,
+// but rarely do for generators stored in other objects.
+// https://www.open-std.org/jtc1/sc22/wg21/docs/papers/2018/p0981r0.html
+//
+// Every benchmark below folds the same stream of integers - the first `count` outputs of `splitmix64`,
+// keeping the ones divisible by 3 - through two stages: a source and a filter. The coroutines are compared to
+// callbacks, iterators and hand-written state machines doing the same. It takes C++20, so this section is only
+// compiled into the `tutorial_cpp20` target.
+#if defined(__cpp_lib_coroutine)
+
+inline std::uint64_t coroutine_stream_value(std::size_t index) noexcept { return splitmix64(index); }
+inline bool coroutine_stream_keeps(std::uint64_t value) noexcept { return value % 3 == 0; }
+
+/// @brief  Frame allocation policy and counters shared by all of the promise types below.
+///
+/// The compiler forwards the arguments of a coroutine to `operator new` of its promise, if a matching overload
+/// exists. So coroutines taking `std::allocator_arg` and a `std::pmr::memory_resource *` as their first arguments
+/// place their frames in that resource, and all others go to the heap. The resource is stored right after
+/// the frame, as `operator delete` only receives the pointer and the size.
+struct coroutine_promise_base_t {
+    static inline thread_local std::size_t frames = 0;           ///< Promises constructed, allocated or elided
+    static inline thread_local std::size_t heap_allocations = 0; ///< Frames placed on the global heap
+
+    coroutine_promise_base_t() noexcept { ++frames; }
+
+    static void *operator new(std::size_t size) { return allocate(size, std::pmr::new_delete_resource()); }
+
+    template <typename... arguments_at>
+    static void *operator new(std::size_t size, std::allocator_arg_t, std::pmr::memory_resource *resource,
+                              arguments_at const &...) {
+        return allocate(size, resource);
+    }
+
+    static void operator delete(void *frame, std::size_t size) noexcept {
+        std::pmr::memory_resource *resource;
+        std::memcpy(&resource, static_cast<std::byte *>(frame) + padded(size), sizeof(resource));
+        resource->deallocate(frame, padded(size) + sizeof(resource), alignof(std::max_align_t));
+    }
+
+  private:
+    static std::size_t padded(std::size_t size) noexcept {
+        return (size + alignof(void *) - 1) / alignof(void *) * alignof(void *);
+    }
+
+    static void *allocate(std::size_t size, std::pmr::memory_resource *resource) {
+        heap_allocations += resource == std::pmr::new_delete_resource();
+        void *frame = resource->allocate(padded(size) + sizeof(resource), alignof(std::max_align_t));
+        std::memcpy(static_cast<std::byte *>(frame) + padded(size), &resource, sizeof(resource));
+        return frame;
+    }
+};
+
+/// @brief  Minimal lazy generator, yielding values by copy, until C++23 brings `std::generator`.
+template <typename value_at> class generator_gt {
+  public:
+    struct promise_type : public coroutine_promise_base_t {
+        value_at value;
+
+        generator_gt get_return_object() noexcept { return generator_gt(handle_t::from_promise(*this)); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_always final_suspend() const noexcept { return {}; }
+        std::suspend_always yield_value(value_at yielded) noexcept {
+            value = yielded;
+            return {};
+        }
+        void return_void() const noexcept {}
+        void unhandled_exception() const { throw; }
+    };
+    using handle_t = std::coroutine_handle<promise_type>;
+
+    class iterator {
+      public:
+        explicit iterator(handle_t handle) noexcept : handle_(handle) {}
+        value_at const &operator*() const noexcept { return handle_.promise().value; }
+        iterator &operator++() {
+            handle_.resume();
+            return *this;
+        }
+        bool operator!=(std::default_sentinel_t) const noexcept { return !handle_.done(); }
+
+      private:
+        handle_t handle_;
+    };
+
+    generator_gt(generator_gt &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    generator_gt &operator=(generator_gt &&) = delete;
+    ~generator_gt() noexcept {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    iterator begin() {
+        handle_.resume();
+        return iterator(handle_);
+    }
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+  private:
+    handle_t handle_;
+
+    explicit generator_gt(handle_t handle) noexcept : handle_(handle) {}
+};
+
+generator_gt<std::uint64_t> stream_generator(std::allocator_arg_t, std::pmr::memory_resource *, std::size_t begin,
+                                             std::size_t end) {
+    for (std::size_t index = begin; index != end; ++index)
+        co_yield coroutine_stream_value(index);
+}
+
+generator_gt<std::uint64_t> filter_generator(std::allocator_arg_t, std::pmr::memory_resource *,
+                                             generator_gt<std::uint64_t> source) {
+    for (std::uint64_t value : source)
+        if (coroutine_stream_keeps(value))
+            co_yield value;
+}
+
+/// Pull-style source stage: an input iterator over the stream.
+class stream_iterator_t {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::uint64_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::uint64_t;
+
+    explicit stream_iterator_t(std::size_t index) noexcept : index_(index) {}
+    std::uint64_t operator*() const noexcept { return coroutine_stream_value(index_); }
+    stream_iterator_t &operator++() noexcept {
+        ++index_;
+        return *this;
+    }
+    bool operator==(stream_iterator_t const &other) const noexcept { return index_ == other.index_; }
+    bool operator!=(stream_iterator_t const &other) const noexcept { return index_ != other.index_; }
+
+  private:
+    std::size_t index_;
+};
+
+/// Pull-style filter stage: wraps any other iterator, skipping ahead to the next kept value on every increment.
+template <typename iterator_at> class filter_iterator_gt {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::uint64_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::uint64_t;
+
+    filter_iterator_gt(iterator_at current, iterator_at end) noexcept : current_(current), end_(end) { skip_(); }
+    std::uint64_t operator*() const noexcept { return *current_; }
+    filter_iterator_gt &operator++() noexcept {
+        ++current_;
+        skip_();
+        return *this;
+    }
+    bool operator==(filter_iterator_gt const &other) const noexcept { return current_ == other.current_; }
+    bool operator!=(filter_iterator_gt const &other) const noexcept { return current_ != other.current_; }
+
+  private:
+    iterator_at current_, end_;
+
+    void skip_() noexcept {
+        while (current_ != end_ && !coroutine_stream_keeps(*current_))
+            ++current_;
+    }
+};
+
+/// Push-style source stage: every value is handed to the next stage through a type-erased callback,
+/// the way event handlers are usually chained.
+inline void stream_callbacks(std::size_t count, std::function<void(std::uint64_t)> const &consumer) {
+    for (std::size_t index = 0; index != count; ++index)
+        consumer(coroutine_stream_value(index));
+}
+
+/// Source stage as a state machine, that the index alone describes.
+class stream_source_machine_t {
+  public:
+    explicit stream_source_machine_t(std::size_t count) noexcept : count_(count) {}
+    bool next(std::uint64_t &value) noexcept {
+        if (index_ == count_)
+            return false;
+        value = coroutine_stream_value(index_++);
+        return true;
+    }
+
+  private:
+    std::size_t index_ = 0, count_;
+};
+
+/// @brief  Filter stage as a state machine: what the compiler turns `filter_generator` into, written by hand.
+///
+/// The `switch` jumps right back into the loop body where the last call returned from, like a coroutine
+/// resumes after its last `co_yield`. Unlike a coroutine, it needs no frame allocation, and the calls are direct.
+template <typename source_at> class filter_machine_gt {
+  public:
+    explicit filter_machine_gt(source_at source) noexcept : source_(source) {}
+    bool next(std::uint64_t &value) noexcept {
+        switch (state_) {
+        case state_t::started_k:
+            while (source_.next(value)) {
+                if (!coroutine_stream_keeps(value))
+                    continue;
+                state_ = state_t::suspended_k;
+                return true;
+            case state_t::suspended_k:;
+            }
+            state_ = state_t::finished_k;
+            [[fallthrough]];
+        case state_t::finished_k:
+            return false;
+        }
+        return false;
+    }
+
+  private:
+    enum class state_t { started_k, suspended_k, finished_k };
+    source_at source_;
+    state_t state_ = state_t::started_k;
+};
+
+/// Snapshots the clock and the frame counters, to report the time per element and the allocations per frame.
+class coroutine_counters_t {
+  public:
+    void report(bm::State &state, std::size_t elements_per_iteration) const {
+        double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        double const elements = static_cast<double>(elements_per_iteration) * state.iterations();
+        std::size_t const frames = coroutine_promise_base_t::frames - frames_;
+        state.SetItemsProcessed(static_cast<std::int64_t>(elements));
+        state.counters["ns_per_element"] = seconds * 1e9 / elements;
+        if (!frames)
+            return;
+        state.counters["frames_per_element"] = frames / elements;
+        state.counters["heap_allocations_per_frame"] =
+            static_cast<double>(coroutine_promise_base_t::heap_allocations - heap_allocations_) / frames;
+    }
+
+  private:
+    std::size_t frames_ = coroutine_promise_base_t::frames;
+    std::size_t heap_allocations_ = coroutine_promise_base_t::heap_allocations;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};
+
+constexpr std::size_t coroutine_stream_count_k = 1 << 16;
+
+static void coroutine_stream_iterators(bm::State &state) {
+    coroutine_counters_t counters;
+    for (auto _ : state) {
+        stream_iterator_t begin(0), end(coroutine_stream_count_k);
+        std::uint64_t sum = std::accumulate(filter_iterator_gt<stream_iterator_t>(begin, end),
+                                            filter_iterator_gt<stream_iterator_t>(end, end), std::uint64_t(0));
+        bm::DoNotOptimize(sum);
+    }
+    counters.report(state, coroutine_stream_count_k);
+}
+
+static void coroutine_stream_callbacks(bm::State &state) {
+    coroutine_counters_t counters;
+    for (auto _ : state) {
+        std::uint64_t sum = 0;
+        std::function<void(std::uint64_t)> sink = [&](std::uint64_t value) { sum += value; };
+        std::function<void(std::uint64_t)> filter = [&](std::uint64_t value) {
+            if (coroutine_stream_keeps(value))
+                sink(value);
+        };
+        stream_callbacks(coroutine_stream_count_k, filter);
+        bm::DoNotOptimize(sum);
+    }
+    counters.report(state, coroutine_stream_count_k);
+}
+
+static void coroutine_stream_state_machines(bm::State &state) {
+    coroutine_counters_t counters;
+    for (auto _ : state) {
+        filter_machine_gt<stream_source_machine_t> machine{stream_source_machine_t(coroutine_stream_count_k)};
+        std::uint64_t sum = 0, value;
+        while (machine.next(value))
+            sum += value;
+        bm::DoNotOptimize(sum);
+    }
+    counters.report(state, coroutine_stream_count_k);
+}
+
+static void coroutine_stream_generators(bm::State &state) {
+    coroutine_counters_t counters;
+    std::pmr::memory_resource *heap = std::pmr::new_delete_resource();
+    for (auto _ : state) {
+        std::uint64_t sum = 0;
+        for (std::uint64_t value : filter_generator(
+                 std::allocator_arg, heap, stream_generator(std::allocator_arg, heap, 0, coroutine_stream_count_k)))
+            sum += value;
+        bm::DoNotOptimize(sum);
+    }
+    counters.report(state, coroutine_stream_count_k);
+}
+
+// The state machines and the iterators compile into the same loop, and the rest is the price of abstraction:
+// an indirect call per element and stage for the callbacks, and an indirect jump per resumption for coroutines,
+// which end up ~50% slower. The two frames are allocated once per stream, so they hardly matter here.
+BENCHMARK(coroutine_stream_iterators);
+BENCHMARK(coroutine_stream_callbacks);
+BENCHMARK(coroutine_stream_state_machines);
+BENCHMARK(coroutine_stream_generators);
+
+/// @brief  Lazy task, that starts when awaited, and resumes the awaiting coroutine once it finishes.
+///
+/// Both hand-offs use "symmetric transfer": `await_suspend` returns the handle to resume next, and the compiler
+/// jumps to it with a tail call. Resuming it with a plain call instead would grow the stack with every
+/// completed task, and overflow it on long chains.
+template <typename value_at> class task_gt {
+  public:
+    struct promise_type : public coroutine_promise_base_t {
+        value_at value{};
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        task_gt get_return_object() noexcept { return task_gt(handle_t::from_promise(*this)); }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        auto final_suspend() const noexcept {
+            struct final_awaiter_t {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(handle_t handle) const noexcept {
+                    return handle.promise().continuation;
+                }
+                void await_resume() const noexcept {}
+            };
+            return final_awaiter_t{};
+        }
+        void return_value(value_at returned) noexcept { value = returned; }
+        void unhandled_exception() const { throw; }
+    };
+    using handle_t = std::coroutine_handle<promise_type>;
+
+    task_gt(task_gt &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    task_gt &operator=(task_gt &&) = delete;
+    ~task_gt() noexcept {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+    value_at await_resume() const noexcept { return handle_.promise().value; }
+
+    /// Runs a top-level task to completion. Only valid if it never awaits anything but other tasks.
+    value_at get() {
+        handle_.resume();
+        return handle_.promise().value;
+    }
+
+  private:
+    handle_t handle_;
+
+    explicit task_gt(handle_t handle) noexcept : handle_(handle) {}
+};
+
+task_gt<std::uint64_t> chain_task(std::uint64_t value, std::size_t depth) {
+    if (depth == 0)
+        co_return value;
+    co_return co_await chain_task(value, depth - 1) + 1;
+}
+
+/// The compiler is free to turn this recursion into a loop, and it does. Callbacks and coroutines don't allow that.
+inline std::uint64_t chain_function(std::uint64_t value, std::size_t depth) noexcept {
+    return depth == 0 ? value : chain_function(value, depth - 1) + 1;
+}
+
+/// Continuation-passing style: every level wraps the continuation of its caller into a new callback.
+inline void chain_callbacks(std::uint64_t value, std::size_t depth,
+                            std::function<void(std::uint64_t)> const &continuation) {
+    if (depth == 0)
+        return continuation(value);
+    chain_callbacks(value, depth - 1, [&continuation](std::uint64_t result) { continuation(result + 1); });
+}
+
+enum chain_variant_t { chain_function_k, chain_callbacks_k, chain_tasks_k };
+
+static void coroutine_chain(bm::State &state) {
+    constexpr std::size_t count = 1 << 12;
+    auto depth = static_cast<std::size_t>(state.range(0));
+    auto variant = static_cast<chain_variant_t>(state.range(1));
+    coroutine_counters_t counters;
+    for (auto _ : state) {
+        std::uint64_t sum = 0;
+        for (std::size_t index = 0; index != count; ++index) {
+            std::uint64_t const value = coroutine_stream_value(index);
+            switch (variant) {
+            case chain_function_k:
+                sum += chain_function(value, depth);
+                break;
+            case chain_callbacks_k:
+                chain_callbacks(value, depth, [&](std::uint64_t result) { sum += result; });
+                break;
+            case chain_tasks_k:
+                sum += chain_task(value, depth).get();
+                break;
+            }
+        }
+        bm::DoNotOptimize(sum);
+    }
+    counters.report(state, count);
+}
+
+// Every awaited task is a separate frame, so the costs grow linearly with depth: ~50 ns per level to allocate,
+// initialize, jump in and out, and free it. The callbacks avoid the heap, as a captured reference fits into
+// the small buffer of `std::function`, and pay ~15 ns per level for constructing it and calling through it.
+// The stack stays flat either way: a chain of a million tasks completes, as long as tail calls are enabled.
+BENCHMARK(coroutine_chain)
+    ->ArgNames({"depth", "variant"})
+    ->ArgsProduct({{1, 4, 16, 64}, {chain_function_k, chain_callbacks_k, chain_tasks_k}});
+
+enum frame_resource_t { frame_heap_k, frame_pool_k, frame_arena_k };
+
+/// @brief  Producer/consumer pipelines, rebuilt for every batch of the stream, as per-request handlers would be.
+///
+/// Small batches amortize the frame allocations over fewer elements. Placing the frames into a pool, that
+/// recycles blocks of the same size, or into an arena, that is reset after every batch, removes the heap from
+/// the picture entirely.
+static void coroutine_pipeline_batches(bm::State &state) {
+    auto batch = static_cast<std::size_t>(state.range(0));
+    auto resource_kind = static_cast<frame_resource_t>(state.range(1));
+    std::pmr::unsynchronized_pool_resource pool;
+    arena_resource_t arena;
+    std::pmr::memory_resource *resource = std::pmr::new_delete_resource();
+    if (resource_kind == frame_pool_k)
+        resource = &pool;
+    if (resource_kind == frame_arena_k)
+        resource = &arena;
+
+    coroutine_counters_t counters;
+    for (auto _ : state) {
+        std::uint64_t sum = 0;
+        for (std::size_t begin = 0; begin != coroutine_stream_count_k; begin += batch) {
+            for (std::uint64_t value :
+                 filter_generator(std::allocator_arg, resource,
+                                  stream_generator(std::allocator_arg, resource, begin, begin + batch)))
+                sum += value;
+            if (resource_kind == frame_arena_k)
+                arena.reset();
+        }
+        bm::DoNotOptimize(sum);
+    }
+    counters.report(state, coroutine_stream_count_k);
+}
+
+BENCHMARK(coroutine_pipeline_batches)
+    ->ArgNames({"batch", "resource"})
+    ->ArgsProduct({{16, 256, 4096}, {frame_heap_k, frame_pool_k, frame_arena_k}});
+
+#endif // defined(__cpp_lib_coroutine)
+
+// ------------------------------------
+// ## Message Passing Between Cores
+// ------------------------------------
+//
+// Pipeline stages on different cores talk through queues, and the cost of every message is dominated by
+// cache-coherence traffic: the line holding an index or a slot bounces between the private caches of the two
+// cores. How far it travels depends on where the cores are - in the same physical core, behind the same L3
+// slice, or on different sockets - so the benchmarks below pin producers and consumers to pairs of CPUs
+// chosen from the topology.
+
+enum cpu_distance_t {
+    cpu_distance_unpinned_k, ///< Leave the placement to the OS scheduler
+    cpu_distance_smt_k,      ///< Two hyper-threads of the same physical core, sharing L1 and L2
+    cpu_distance_l3_k,       ///< Two physical cores sharing the last-level cache, like an AMD CCX
+    cpu_distance_package_k,  ///< Two cores of the same socket, behind different last-level caches
+    cpu_distance_sockets_k,  ///< Two cores on different sockets, talking over the inter-socket link
+    cpu_distances_count_k,
+};
+
+inline char const *cpu_distance_name(cpu_distance_t distance) noexcept {
+    switch (distance) {
+    case cpu_distance_unpinned_k:
+        return "unpinned";
+    case cpu_distance_smt_k:
+        return "same_core";
+    case cpu_distance_l3_k:
+        return "same_l3";
+    case cpu_distance_package_k:
+        return "same_socket";
+    case cpu_distance_sockets_k:
+        return "cross_socket";
+    default:
+        return "unknown";
+    }
+}
+
+/// @brief  Picks two logical CPUs at the given distance from each other.
+///         Returns an empty vector, if the machine has no such pair, and two unpinnable CPUs for "unpinned".
+inline std::vector<logical_cpu_t> cpu_pair(cpu_distance_t distance) {
+    if (distance == cpu_distance_unpinned_k)
+        return std::vector<logical_cpu_t>(2);
+    std::vector<logical_cpu_t> const cpus = available_cpus();
+    for (logical_cpu_t const &first : cpus)
+        for (logical_cpu_t const &second : cpus) {
+            if (first.id < 0 || second.id < 0 || first.id == second.id)
+                continue;
+            bool const same_package = first.package == second.package;
+            bool const same_core = same_package && first.core == second.core;
+            bool const same_l3 = same_package && first.l3 == second.l3;
+            bool matches = false;
+            switch (distance) {
+            case cpu_distance_smt_k:
+                matches = same_core;
+                break;
+            case cpu_distance_l3_k:
+                matches = same_l3 && !same_core;
+                break;
+            case cpu_distance_package_k:
+                matches = same_package && !same_l3;
+                break;
+            case cpu_distance_sockets_k:
+                matches = !same_package;
+                break;
+            default:
+                break;
+            }
+            if (matches)
+                return {first, second};
+        }
+    return {};
+}
+
+/// @brief  Busy-waits politely. The `pause` instruction frees the pipeline for the SMT sibling, and saves power.
+///         After a while we give up the whole time-slice, in case the other side is waiting for our core.
+inline void spin_pause(std::size_t &attempts) noexcept {
+    if (++attempts < 64) {
+#if defined(__x86_64__) || defined(_M_X64)
+        _mm_pause();
+#endif
+    } else
+        std::this_thread::yield();
+}
+
+/// Retries a non-blocking batch operation until it moves at least one element.
+template <typename attempt_at> std::size_t spin_until_some(attempt_at &&attempt) noexcept {
+    std::size_t moved = 0;
+    for (std::size_t attempts = 0; !(moved = attempt());)
+        spin_pause(attempts);
+    return moved;
+}
+
+/// @brief  Places the states of the two sides of a queue and an array of slots into one allocation,
+///         with every side on its own cache lines.
+///
+/// The line size is only known at runtime, so instead of `alignas`, the stride between the parts is computed
+/// from `memory_specs_t::cache_line_size`. It spans two lines: Intel cores prefetch lines in adjacent pairs,
+/// and a single line of padding still lets the two sides contend.
+template <typename first_at, typename second_at, typename slot_at> class padded_layout_gt {
+  public:
+    padded_layout_gt(std::size_t slots, std::size_t cache_line_size) : slots_(slots) {
+        if (!cache_line_size || (cache_line_size & (cache_line_size - 1)))
+            cache_line_size = 64;
+        alignment_ = std::max({cache_line_size, alignof(first_at), alignof(second_at), alignof(slot_at)});
+        std::size_t const largest = std::max({2 * cache_line_size, sizeof(first_at), sizeof(second_at)});
+        stride_ = (largest + alignment_ - 1) / alignment_ * alignment_;
+        memory_ = static_cast<std::byte *>(
+            ::operator new(2 * stride_ + slots_ * sizeof(slot_at), std::align_val_t(alignment_)));
+        new (memory_) first_at();
+        new (memory_ + stride_) second_at();
+        for (std::size_t i = 0; i != slots_; ++i)
+            new (memory_ + 2 * stride_ + i * sizeof(slot_at)) slot_at();
+    }
+    ~padded_layout_gt() noexcept {
+        first().~first_at();
+        second().~second_at();
+        for (std::size_t i = 0; i != slots_; ++i)
+            slots()[i].~slot_at();
+        ::operator delete(memory_, std::align_val_t(alignment_));
+    }
+    padded_layout_gt(padded_layout_gt const &) = delete;
+    padded_layout_gt &operator=(padded_layout_gt const &) = delete;
+
+    first_at &first() noexcept { return *std::launder(reinterpret_cast<first_at *>(memory_)); }
+    second_at &second() noexcept { return *std::launder(reinterpret_cast<second_at *>(memory_ + stride_)); }
+    slot_at *slots() noexcept { return std::launder(reinterpret_cast<slot_at *>(memory_ + 2 * stride_)); }
+
+  private:
+    std::byte *memory_ = nullptr;
+    std::size_t slots_ = 0;
+    std::size_t alignment_ = 0;
+    std::size_t stride_ = 0;
+};
+
+inline std::size_t round_up_to_power_of_two(std::size_t x) noexcept {
+    std::size_t power = 1;
+    while (power < x)
+        power <<= 1;
+    return power;
+}
+
+/// @brief  Bounded single-producer single-consumer ring buffer, with cached indices and batch operations.
+///
+/// The producer owns the `tail`, and the consumer owns the `head`. Reading the index of the other side costs
+/// a cache miss whenever it has changed, so each side keeps a stale copy, and only refreshes it when the ring
+/// looks full or empty. Batches publish many elements with a single store.
+/// https://rigtorp.se/ringbuffer/
+template <typename element_at> class spsc_ring_gt {
+    static_assert(std::is_trivially_copyable<element_at>::value, "Elements are copied between threads as is");
+
+  public:
+    explicit spsc_ring_gt(std::size_t capacity, std::size_t cache_line_size = fetch_memory_specs().cache_line_size)
+        : capacity_(round_up_to_power_of_two(capacity)), layout_(capacity_, cache_line_size) {}
+
+    std::size_t try_push(element_at const *elements, std::size_t count) noexcept {
+        producer_t &producer = layout_.first();
+        std::size_t const tail = producer.tail.load(std::memory_order_relaxed);
+        if (capacity_ - (tail - producer.cached_head) < count)
+            producer.cached_head = layout_.second().head.load(std::memory_order_acquire);
+        count = std::min(count, capacity_ - (tail - producer.cached_head));
+        element_at *slots = layout_.slots();
+        for (std::size_t i = 0; i != count; ++i)
+            slots[(tail + i) & (capacity_ - 1)] = elements[i];
+        if (count)
+            producer.tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    std::size_t try_pop(element_at *elements, std::size_t count) noexcept {
+        consumer_t &consumer = layout_.second();
+        std::size_t const head = consumer.head.load(std::memory_order_relaxed);
+        if (consumer.cached_tail - head < count)
+            consumer.cached_tail = layout_.first().tail.load(std::memory_order_acquire);
+        count = std::min(count, consumer.cached_tail - head);
+        element_at const *slots = layout_.slots();
+        for (std::size_t i = 0; i != count; ++i)
+            elements[i] = slots[(head + i) & (capacity_ - 1)];
+        if (count)
+            consumer.head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    void push(element_at const *elements, std::size_t count) noexcept {
+        while (count) {
+            std::size_t const pushed = spin_until_some([&] { return try_push(elements, count); });
+            elements += pushed, count -= pushed;
+        }
+    }
+    std::size_t pop(element_at *elements, std::size_t count) noexcept {
+        return spin_until_some([&] { return try_pop(elements, count); });
+    }
+
+  private:
+    struct producer_t {
+        std::atomic<std::size_t> tail{0};
+        std::size_t cached_head = 0;
+    };
+    struct consumer_t {
+        std::atomic<std::size_t> head{0};
+        std::size_t cached_tail = 0;
+    };
+
+    std::size_t capacity_;
+    padded_layout_gt<producer_t, consumer_t, element_at> layout_;
+};
+
+/// @brief  Bounded multi-producer multi-consumer ring buffer, after Dmitry Vyukov's design.
+///
+/// Every slot carries a sequence number, telling which lap of the ring it expects next, so producers and
+/// consumers only contend on their own position counter, and never read the counter of the other side.
+/// A batch claims several consecutive slots with one CAS, once the last of them is ready. The earlier ones
+/// were claimed by the other side before it, so at worst we wait for those operations to complete.
+/// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+template <typename element_at> class mpmc_ring_gt {
+    static_assert(std::is_trivially_copyable<element_at>::value, "Elements are copied between threads as is");
+
+  public:
+    explicit mpmc_ring_gt(std::size_t capacity, std::size_t cache_line_size = fetch_memory_specs().cache_line_size)
+        : capacity_(round_up_to_power_of_two(capacity)), layout_(capacity_, cache_line_size) {
+        for (std::size_t i = 0; i != capacity_; ++i)
+            layout_.slots()[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    std::size_t try_push(element_at const *elements, std::size_t count) noexcept {
+        std::size_t position;
+        if (!(count = claim_(layout_.first().position, std::min(count, capacity_), 0, position)))
+            return 0;
+        for (std::size_t i = 0; i != count; ++i) {
+            slot_t &slot = slot_(position + i);
+            for (std::size_t attempts = 0; slot.sequence.load(std::memory_order_acquire) != position + i;)
+                spin_pause(attempts);
+            slot.element = elements[i];
+            slot.sequence.store(position + i + 1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    std::size_t try_pop(element_at *elements, std::size_t count) noexcept {
+        std::size_t position;
+        if (!(count = claim_(layout_.second().position, std::min(count, capacity_), 1, position)))
+            return 0;
+        for (std::size_t i = 0; i != count; ++i) {
+            slot_t &slot = slot_(position + i);
+            for (std::size_t attempts = 0; slot.sequence.load(std::memory_order_acquire) != position + i + 1;)
+                spin_pause(attempts);
+            elements[i] = slot.element;
+            slot.sequence.store(position + i + capacity_, std::memory_order_release);
+        }
+        return count;
+    }
+
+    void push(element_at const *elements, std::size_t count) noexcept {
+        while (count) {
+            std::size_t const pushed = spin_until_some([&] { return try_push(elements, count); });
+            elements += pushed, count -= pushed;
+        }
+    }
+    std::size_t pop(element_at *elements, std::size_t count) noexcept {
+        return spin_until_some([&] { return try_pop(elements, count); });
+    }
+
+  private:
+    struct position_t {
+        std::atomic<std::size_t> position{0};
+    };
+    struct slot_t {
+        std::atomic<std::size_t> sequence{0};
+        element_at element{};
+    };
+
+    std::size_t capacity_;
+    padded_layout_gt<position_t, position_t, slot_t> layout_;
+
+    slot_t &slot_(std::size_t position) noexcept { return layout_.slots()[position & (capacity_ - 1)]; }
+
+    /// Claims up to `count` slots, halving the batch until its last slot is ready. Producers expect
+    /// the sequence to match the position, and consumers expect it to be one ahead, hence the `lap_offset`.
+    std::size_t claim_(std::atomic<std::size_t> &counter, std::size_t count, std::size_t lap_offset,
+                       std::size_t &position) noexcept {
+        position = counter.load(std::memory_order_relaxed);
+        while (count) {
+            std::size_t const last = position + count - 1;
+            auto const lag =
+                static_cast<std::ptrdiff_t>(slot_(last).sequence.load(std::memory_order_acquire) - (last + lap_offset));
+            if (lag == 0) {
+                if (counter.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+                    break;
+            } else if (lag < 0)
+                count /= 2;
+            else
+                position = counter.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+};
+
+/// @brief  The baseline: a bounded queue guarded by a single `std::mutex`, with producers and consumers
+///         sleeping on condition variables, while it is full or empty.
+template <typename element_at> class mutex_queue_gt {
+  public:
+    explicit mutex_queue_gt(std::size_t capacity) : slots_(capacity) {}
+
+    void push(element_at const *elements, std::size_t count) {
+        while (count) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [&] { return size_ != slots_.size(); });
+            std::size_t const pushed = std::min(count, slots_.size() - size_);
+            for (std::size_t i = 0; i != pushed; ++i)
+                slots_[(head_ + size_ + i) % slots_.size()] = elements[i];
+            size_ += pushed;
+            lock.unlock();
+            not_empty_.notify_one();
+            elements += pushed, count -= pushed;
+        }
+    }
+
+    std::size_t pop(element_at *elements, std::size_t count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return size_ != 0; });
+        std::size_t const popped = std::min(count, size_);
+        for (std::size_t i = 0; i != popped; ++i)
+            elements[i] = slots_[(head_ + i) % slots_.size()];
+        head_ = (head_ + popped) % slots_.size(), size_ -= popped;
+        lock.unlock();
+        not_full_.notify_one();
+        return popped;
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+    std::vector<element_at> slots_;
+    std::size_t head_ = 0, size_ = 0;
+};
+
+constexpr std::size_t message_queue_capacity_k = 1 << 12;
+
+/// @brief  Streams a million messages from a producer thread to the benchmark thread, in batches of `batch`.
+///         Every message is its own index, and the consumer checks that none is lost or reordered.
+template <typename queue_at> static void message_throughput(bm::State &state) {
+    auto distance = static_cast<cpu_distance_t>(state.range(0));
+    auto batch = static_cast<std::size_t>(state.range(1));
+    state.SetLabel(cpu_distance_name(distance));
+    std::vector<logical_cpu_t> const cpus = cpu_pair(distance), all_cpus = available_cpus();
+    constexpr std::size_t messages = 1 << 20;
+    queue_at queue(message_queue_capacity_k);
+
+    pin_current_thread(cpus[1]);
+    bool in_order = true;
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        std::thread producer([&] {
+            pin_current_thread(cpus[0]);
+            std::vector<std::uint64_t> outgoing(batch);
+            for (std::size_t sent = 0; sent != messages; sent += batch) {
+                std::iota(outgoing.begin(), outgoing.end(), sent);
+                queue.push(outgoing.data(), batch);
+            }
+        });
+        std::vector<std::uint64_t> incoming(batch);
+        for (std::size_t received = 0; received != messages;) {
+            std::size_t const popped = queue.pop(incoming.data(), batch);
+            for (std::size_t i = 0; i != popped; ++i)
+                in_order &= incoming[i] == received + i;
+            received += popped;
+        }
+        producer.join();
+    }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pin_current_thread(all_cpus);
+
+    if (!in_order)
+        return state.SkipWithError("Messages were lost or reordered");
+    state.counters["messages_per_second"] = messages * state.iterations() / seconds;
+}
+
+/// @brief  Bounces a single message between the benchmark thread and an echo thread, over two queues.
+///         The time of every iteration is the round-trip latency.
+template <typename queue_at> static void message_round_trip(bm::State &state) {
+    auto distance = static_cast<cpu_distance_t>(state.range(0));
+    state.SetLabel(cpu_distance_name(distance));
+    std::vector<logical_cpu_t> const cpus = cpu_pair(distance), all_cpus = available_cpus();
+    queue_at requests(message_queue_capacity_k), responses(message_queue_capacity_k);
+    constexpr std::uint64_t stop_k = std::numeric_limits<std::uint64_t>::max();
+
+    std::thread echo([&] {
+        pin_current_thread(cpus[0]);
+        for (std::uint64_t message = 0; message != stop_k;) {
+            requests.pop(&message, 1);
+            responses.push(&message, 1);
+        }
+    });
+    pin_current_thread(cpus[1]);
+    std::uint64_t message = 0;
+    for (auto _ : state) {
+        requests.push(&message, 1);
+        responses.pop(&message, 1);
+        ++message;
+    }
+    requests.push(&stop_k, 1);
+    responses.pop(&message, 1);
+    echo.join();
+    pin_current_thread(all_cpus);
+}
+
+/// @brief  Fans in the messages of several unpinned producers into one consumer. Only the queues
+///         supporting multiple producers take part.
+template <typename queue_at> static void message_fan_in(bm::State &state) {
+    auto producers = static_cast<std::size_t>(state.range(0));
+    auto batch = static_cast<std::size_t>(state.range(1));
+    constexpr std::size_t messages = 1 << 20;
+    queue_at queue(message_queue_capacity_k);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (std::size_t producer = 0; producer != producers; ++producer)
+            threads.emplace_back([&, producer] {
+                std::vector<std::uint64_t> outgoing(batch, producer);
+                for (std::size_t sent = producer * batch; sent < messages; sent += producers * batch)
+                    queue.push(outgoing.data(), std::min(batch, messages - sent));
+            });
+        std::vector<std::uint64_t> incoming(batch);
+        for (std::size_t received = 0; received != messages;)
+            received += queue.pop(incoming.data(), batch);
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    state.counters["messages_per_second"] = messages * state.iterations() / seconds;
+}
+
+/// Lists only the distances, that the current machine can provide.
+inline std::vector<std::int64_t> available_cpu_distances() {
+    std::vector<std::int64_t> distances;
+    for (int distance = 0; distance != cpu_distances_count_k; ++distance)
+        if (!cpu_pair(static_cast<cpu_distance_t>(distance)).empty())
+            distances.push_back(distance);
+    return distances;
+}
+
+static void message_throughput_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"distance", "batch"})->ArgsProduct({available_cpu_distances(), {1, 16, 256}});
+    benchmark->UseRealTime();
+}
+
+static void message_round_trip_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"distance"})->ArgsProduct({available_cpu_distances()});
+    benchmark->UseRealTime();
+}
+
+// With single messages, every refresh of a cached index in the SPSC ring is a cache miss, whose cost grows with
+// the distance between the cores. Batches of 16 amortize those misses, and hide most of the distance.
+// The MPMC ring pays for a CAS on every claim, and the mutex queue for the lock and the wake-ups,
+// so both fall far behind on small messages, and catch up with larger batches.
+BENCHMARK_TEMPLATE(message_throughput, spsc_ring_gt<std::uint64_t>)->Apply(message_throughput_arguments);
+BENCHMARK_TEMPLATE(message_throughput, mpmc_ring_gt<std::uint64_t>)->Apply(message_throughput_arguments);
+BENCHMARK_TEMPLATE(message_throughput, mutex_queue_gt<std::uint64_t>)->Apply(message_throughput_arguments);
+
+// For the rings, a round trip is little more than two cache-line transfers, so it directly shows the distance:
+// SMT siblings share the L1, cores of a socket meet in the L3, and sockets go through the interconnect.
+// The mutex queue puts the echo thread to sleep instead, and a futex wake-up alone takes microseconds.
+// It only wins when both threads share one CPU, as the unpinned ones do on a single-core VM: the spinning side
+// then burns its time-slice, while the other side can't run, and every message waits for the scheduler.
+BENCHMARK_TEMPLATE(message_round_trip, spsc_ring_gt<std::uint64_t>)->Apply(message_round_trip_arguments);
+BENCHMARK_TEMPLATE(message_round_trip, mpmc_ring_gt<std::uint64_t>)->Apply(message_round_trip_arguments);
+BENCHMARK_TEMPLATE(message_round_trip, mutex_queue_gt<std::uint64_t>)->Apply(message_round_trip_arguments);
+
+BENCHMARK_TEMPLATE(message_fan_in, mpmc_ring_gt<std::uint64_t>)
+    ->ArgNames({"producers", "batch"})
+    ->ArgsProduct({{1, 2, 4}, {1, 16}})
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(message_fan_in, mutex_queue_gt<std::uint64_t>)
+    ->ArgNames({"producers", "batch"})
+    ->ArgsProduct({{1, 2, 4}, {1, 16}})
+    ->UseRealTime();
+
+// ------------------------------------
+// ## Atomics Under Contention
+// ------------------------------------
+//
+// The `i32_addition_random` benchmark at the very top slows down by two orders of magnitude with 8 threads,
+// because `std::rand()` hides a lock around its global state. The same happens to every atomic variable, that
+// several cores write: the line holding it must travel to the writer's private cache in the "Modified" state,
+// and the more cores compete for it, and the further they are from each other, the longer every operation waits.
+//
+// The benchmarks below repeat the common atomic operations under every meaningful `std::memory_order`,
+// with a growing number of threads, that either hammer one shared line, or each update their own line.
+// The sharing threads are either packed into the fewest last-level caches and sockets, or dealt across them.
+
+enum atomic_operation_t {
+    atomic_load_k,
+    atomic_store_k,
+    atomic_exchange_k,
+    atomic_fetch_add_k,
+    atomic_cas_loop_k, ///< An increment via `compare_exchange_weak`, the way any custom read-modify-write is done
+    atomic_operations_count_k,
+};
+
+inline char const *atomic_operation_name(atomic_operation_t operation) noexcept {
+    switch (operation) {
+    case atomic_load_k:
+        return "load";
+    case atomic_store_k:
+        return "store";
+    case atomic_exchange_k:
+        return "exchange";
+    case atomic_fetch_add_k:
+        return "fetch_add";
+    case atomic_cas_loop_k:
+        return "cas_loop";
+    default:
+        return "unknown";
+    }
+}
+
+inline char const *memory_order_name(std::memory_order order) noexcept {
+    switch (order) {
+    case std::memory_order_relaxed:
+        return "relaxed";
+    case std::memory_order_consume:
+        return "consume";
+    case std::memory_order_acquire:
+        return "acquire";
+    case std::memory_order_release:
+        return "release";
+    case std::memory_order_acq_rel:
+        return "acq_rel";
+    case std::memory_order_seq_cst:
+        return "seq_cst";
+    default:
+        return "unknown";
+    }
+}
+
+/// The strongest order, that a plain load may take, out of the order of a read-modify-write.
+constexpr std::memory_order load_order(std::memory_order order) noexcept {
+    return order == std::memory_order_release   ? std::memory_order_relaxed
+           : order == std::memory_order_acq_rel ? std::memory_order_acquire
+                                                : order;
+}
+
+/// The strongest order, that a plain store may take, out of the order of a read-modify-write.
+constexpr std::memory_order store_order(std::memory_order order) noexcept {
+    return order == std::memory_order_acquire   ? std::memory_order_relaxed
+           : order == std::memory_order_acq_rel ? std::memory_order_release
+                                                : order;
+}
+
+/// Only the orders, that the standard allows for the operation, are benchmarked.
+/// `consume` is skipped everywhere, as every compiler promotes it to `acquire`.
+inline bool atomic_order_applies(atomic_operation_t operation, std::memory_order order) noexcept {
+    if (order == std::memory_order_consume)
+        return false;
+    switch (operation) {
+    case atomic_load_k:
+        return load_order(order) == order;
+    case atomic_store_k:
+        return store_order(order) == order;
+    default:
+        return true;
+    }
+}
+
+enum contention_t {
+    contention_one_line_packed_k, ///< All threads update one line, filling one L3 domain before the next
+    contention_separate_lines_k,  ///< Every thread updates its own line, so nothing is shared
+    contention_one_line_spread_k, ///< All threads update one line, dealt across L3 domains and sockets
+    contentions_count_k,
+};
+
+inline char const *contention_name(contention_t contention) noexcept {
+    switch (contention) {
+    case contention_one_line_packed_k:
+        return "one_line/packed";
+    case contention_separate_lines_k:
+        return "separate_lines/packed";
+    case contention_one_line_spread_k:
+        return "one_line/spread";
+    default:
+        return "unknown";
+    }
+}
+
+/// @brief  Orders the available CPUs for the benchmark threads, that are placed in that order.
+///         Packed CPUs fill one L3 domain after the other. Spread ones are dealt like cards: the first CPU of
+///         every domain, alternating the sockets, then the second CPU of every domain, and so on.
+inline std::vector<logical_cpu_t> contention_cpus(bool spread) {
+    std::vector<logical_cpu_t> cpus = available_cpus();
+    auto domain = [](logical_cpu_t const &cpu) { return std::make_pair(cpu.package, cpu.l3); };
+    std::stable_sort(cpus.begin(), cpus.end(),
+                     [&](logical_cpu_t const &a, logical_cpu_t const &b) { return domain(a) < domain(b); });
+    if (!spread)
+        return cpus;
+
+    std::vector<std::vector<logical_cpu_t>> domains;
+    for (logical_cpu_t const &cpu : cpus) {
+        if (domains.empty() || domain(domains.back().front()) != domain(cpu))
+            domains.emplace_back();
+        domains.back().push_back(cpu);
+    }
+    // Rank every domain among the ones on its socket, so that consecutive domains sit on different sockets.
+    std::vector<std::size_t> ranks(domains.size());
+    for (std::size_t i = 0; i != domains.size(); ++i)
+        for (std::size_t j = 0; j != i; ++j)
+            ranks[i] += domains[j].front().package == domains[i].front().package;
+    std::vector<std::size_t> order(domains.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return ranks[a] < ranks[b]; });
+
+    std::vector<logical_cpu_t> dealt;
+    for (std::size_t round = 0; dealt.size() != cpus.size(); ++round)
+        for (std::size_t index : order)
+            if (round < domains[index].size())
+                dealt.push_back(domains[index][round]);
+    return dealt;
+}
+
+/// @brief  An atomic counter for every benchmark thread, each on its own pair of cache lines.
+///         As with `padded_layout_gt`, the stride comes from the line size detected at runtime.
+class contended_counters_t {
+  public:
+    contended_counters_t(std::size_t count, std::size_t cache_line_size) : count_(std::max<std::size_t>(count, 1)) {
+        if (!cache_line_size || (cache_line_size & (cache_line_size - 1)))
+            cache_line_size = 64;
+        alignment_ = std::max(cache_line_size, alignof(counter_t));
+        stride_ = std::max(2 * cache_line_size, sizeof(counter_t));
+        memory_ = static_cast<std::byte *>(::operator new(count_ *stride_, std::align_val_t(alignment_)));
+        for (std::size_t i = 0; i != count_; ++i)
+            new (memory_ + i * stride_) counter_t(0);
+    }
+    ~contended_counters_t() noexcept {
+        for (std::size_t i = 0; i != count_; ++i)
+            at(i).~counter_t();
+        ::operator delete(memory_, std::align_val_t(alignment_));
+    }
+    contended_counters_t(contended_counters_t const &) = delete;
+    contended_counters_t &operator=(contended_counters_t const &) = delete;
+
+    using counter_t = std::atomic<std::uint64_t>;
+    std::size_t size() const noexcept { return count_; }
+    counter_t &at(std::size_t index) noexcept {
+        return *std::launder(reinterpret_cast<counter_t *>(memory_ + index * stride_));
+    }
+
+  private:
+    std::byte *memory_ = nullptr;
+    std::size_t count_ = 0;
+    std::size_t alignment_ = 0;
+    std::size_t stride_ = 0;
+};
+
+/// @brief  Applies the operation `repetitions` times. The memory order has to be a compile-time constant:
+///         GCC and Clang treat any order, that they can't see through, as `seq_cst`.
+template <atomic_operation_t operation_ak, std::memory_order order_ak>
+void atomic_operations(std::atomic<std::uint64_t> &counter, std::size_t repetitions) noexcept {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i != repetitions; ++i) {
+        if constexpr (operation_ak == atomic_load_k)
+            sum += counter.load(load_order(order_ak));
+        else if constexpr (operation_ak == atomic_store_k)
+            counter.store(i, store_order(order_ak));
+        else if constexpr (operation_ak == atomic_exchange_k)
+            sum += counter.exchange(i, order_ak);
+        else if constexpr (operation_ak == atomic_fetch_add_k)
+            counter.fetch_add(1, order_ak);
+        else {
+            std::uint64_t expected = counter.load(std::memory_order_relaxed);
+            while (!counter.compare_exchange_weak(expected, expected + 1, order_ak, load_order(order_ak))) {
+            }
+        }
+    }
+    bm::DoNotOptimize(sum);
+}
+
+using atomic_operations_t = void (*)(std::atomic<std::uint64_t> &, std::size_t) noexcept;
+
+template <atomic_operation_t operation_ak> atomic_operations_t atomic_operations_for(std::memory_order order) {
+    switch (order) {
+    case std::memory_order_relaxed:
+        return &atomic_operations<operation_ak, std::memory_order_relaxed>;
+    case std::memory_order_acquire:
+        return &atomic_operations<operation_ak, std::memory_order_acquire>;
+    case std::memory_order_release:
+        return &atomic_operations<operation_ak, std::memory_order_release>;
+    case std::memory_order_acq_rel:
+        return &atomic_operations<operation_ak, std::memory_order_acq_rel>;
+    default:
+        return &atomic_operations<operation_ak, std::memory_order_seq_cst>;
+    }
+}
+
+inline atomic_operations_t atomic_operations_for(atomic_operation_t operation, std::memory_order order) {
+    switch (operation) {
+    case atomic_load_k:
+        return atomic_operations_for<atomic_load_k>(order);
+    case atomic_store_k:
+        return atomic_operations_for<atomic_store_k>(order);
+    case atomic_exchange_k:
+        return atomic_operations_for<atomic_exchange_k>(order);
+    case atomic_fetch_add_k:
+        return atomic_operations_for<atomic_fetch_add_k>(order);
+    default:
+        return atomic_operations_for<atomic_cas_loop_k>(order);
+    }
+}
+
+/// @brief  Runs on every benchmark thread, pinned in the order of `contention_cpus`. Each thread measures
+///         its own wall time, so `ns_per_op` is the latency seen by an average thread, and `mops_per_second`
+///         is the throughput of all threads together.
+static void atomic_contention(bm::State &state) {
+    auto operation = static_cast<atomic_operation_t>(state.range(0));
+    auto order = static_cast<std::memory_order>(state.range(1));
+    auto contention = static_cast<contention_t>(state.range(2));
+    atomic_operations_t const operations = atomic_operations_for(operation, order);
+    constexpr std::size_t operations_per_iteration = 64;
+
+    static contended_counters_t counters(std::thread::hardware_concurrency(), fetch_memory_specs().cache_line_size);
+    auto const thread_index = static_cast<std::size_t>(state.thread_index());
+    std::atomic<std::uint64_t> &counter =
+        counters.at(contention == contention_separate_lines_k ? thread_index % counters.size() : 0);
+
+    // Google Benchmark runs the first thread on the main one, so it must get its affinity back afterwards.
+    std::vector<logical_cpu_t> const cpus = contention_cpus(contention == contention_one_line_spread_k);
+    std::vector<logical_cpu_t> const all_cpus = available_cpus();
+    pin_current_thread(cpus[thread_index % cpus.size()]);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state)
+        operations(counter, operations_per_iteration);
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pin_current_thread(all_cpus);
+
+    double const performed = static_cast<double>(operations_per_iteration * state.iterations());
+    state.SetLabel(std::string(atomic_operation_name(operation)) + "/" + memory_order_name(order) + "/" +
+                   contention_name(contention));
+    state.counters["ns_per_op"] = bm::Counter(seconds * 1e9 / performed, bm::Counter::kAvgThreads);
+    state.counters["mops_per_second"] = performed / seconds / 1e6;
+}
+
+static void atomic_contention_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"operation", "order", "contention"});
+    std::memory_order const orders[] = {std::memory_order_relaxed, std::memory_order_acquire, std::memory_order_release,
+                                        std::memory_order_acq_rel, std::memory_order_seq_cst};
+    for (int operation = 0; operation != atomic_operations_count_k; ++operation)
+        for (std::memory_order order : orders)
+            for (int contention = 0; contention != contentions_count_k; ++contention)
+                if (atomic_order_applies(static_cast<atomic_operation_t>(operation), order))
+                    benchmark->Args({operation, static_cast<std::int64_t>(order), contention});
+    for (std::int64_t threads : thread_counts())
+        benchmark->Threads(static_cast<int>(threads));
+    benchmark->UseRealTime();
+}
+
+// On x86 every locked instruction is a full barrier, so `exchange`, `fetch_add` and the CAS loop cost the same
+// under any order, and only a `seq_cst` store differs from the others, compiling into an `xchg`. Arm has
+// separate acquiring and releasing instructions, and there the orders start to matter.
+// With one thread, a locked instruction takes 5-10 ns, and a relaxed load is below 1 ns. Once several cores write
+// the same line, every operation waits for the line to arrive, and the total throughput drops below the
+// single-threaded one, while on separate lines it grows linearly with the threads. Spreading the sharing
+// threads across L3 domains and sockets makes every transfer longer, but the CAS loop suffers the most,
+// as its retries grow with the threads: every failed attempt is another transfer of the line.
+BENCHMARK(atomic_contention)->Apply(atomic_contention_arguments);
+
+// ------------------------------------
+// ## Locks and Barriers
+// ------------------------------------
+//
+// Every lock is an atomic variable with a waiting policy around it, so the previous section already explains
+// most of its cost: acquiring a contended lock means pulling its line into the local cache. The designs differ
+// in what the waiters do meanwhile. Spinlocks keep polling the same line, ticket and MCS locks serve the
+// waiters in order, and the `std::mutex` and the futex mutex put them to sleep in the kernel.
+
+/// @brief  Test-and-test-and-set spinlock. Waiters poll with plain loads, that hit their own copy of the line,
+///         and only attempt the `exchange` once the lock looks free.
+class ttas_spinlock_t {
+  public:
+    void lock() noexcept {
+        for (std::size_t attempts = 0;;) {
+            if (!locked_.exchange(true, std::memory_order_acquire))
+                return;
+            while (locked_.load(std::memory_order_relaxed))
+                spin_pause(attempts);
+        }
+    }
+    void unlock() noexcept { locked_.store(false, std::memory_order_release); }
+
+  private:
+    std::atomic<bool> locked_{false};
+};
+
+/// @brief  Ticket lock: every thread draws a ticket, and waits for its number to be served.
+///         It is fair, but every release invalidates the line in the caches of all the waiters.
+class ticket_lock_t {
+  public:
+    void lock() noexcept {
+        std::uint32_t const ticket = next_.fetch_add(1, std::memory_order_relaxed);
+        for (std::size_t attempts = 0; serving_.load(std::memory_order_acquire) != ticket;)
+            spin_pause(attempts);
+    }
+    void unlock() noexcept { serving_.store(serving_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  private:
+    std::atomic<std::uint32_t> next_{0};
+    std::atomic<std::uint32_t> serving_{0};
+};
+
+/// @brief  Mellor-Crummey and Scott queue lock. Every waiter spins on a flag in its own node, and the owner
+///         hands the lock to its successor by writing just that flag, so a release touches one remote line.
+///         The nodes are thread-local, so a thread may hold only one MCS lock at a time.
+class mcs_lock_t {
+    struct node_t {
+        std::atomic<node_t *> next{nullptr};
+        std::atomic<bool> waiting{false};
+    };
+    static node_t &own_node() noexcept {
+        thread_local node_t node;
+        return node;
+    }
+
+  public:
+    void lock() noexcept {
+        node_t &node = own_node();
+        node.next.store(nullptr, std::memory_order_relaxed);
+        node.waiting.store(true, std::memory_order_relaxed);
+        node_t *previous = tail_.exchange(&node, std::memory_order_acq_rel);
+        if (!previous)
+            return;
+        previous->next.store(&node, std::memory_order_release);
+        for (std::size_t attempts = 0; node.waiting.load(std::memory_order_acquire);)
+            spin_pause(attempts);
+    }
+    void unlock() noexcept {
+        node_t &node = own_node();
+        node_t *next = node.next.load(std::memory_order_acquire);
+        if (!next) {
+            // No successor is visible yet: either the queue is empty, or one is just linking itself in.
+            node_t *expected = &node;
+            if (tail_.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+                return;
+            for (std::size_t attempts = 0; !(next = node.next.load(std::memory_order_acquire));)
+                spin_pause(attempts);
+        }
+        next->waiting.store(false, std::memory_order_release);
+    }
+
+  private:
+    std::atomic<node_t *> tail_{nullptr};
+};
+
+#if defined(__linux__)
+
+/// @brief  Mutex built directly on the `futex` system call, after Ulrich Drepper's "Futexes Are Tricky".
+///         The state is 0 when unlocked, 1 when locked, and 2 when locked with possible sleepers,
+///         so an uncontended `unlock` never enters the kernel.
+class futex_mutex_t {
+  public:
+    void lock() noexcept {
+        int state = 0;
+        if (state_.compare_exchange_strong(state, 1, std::memory_order_acquire, std::memory_order_relaxed))
+            return;
+        if (state != 2)
+            state = state_.exchange(2, std::memory_order_acquire);
+        while (state != 0) {
+            ::syscall(SYS_futex, word(), FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+            state = state_.exchange(2, std::memory_order_acquire);
+        }
+    }
+    void unlock() noexcept {
+        if (state_.exchange(0, std::memory_order_release) == 2)
+            ::syscall(SYS_futex, word(), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+  private:
+    int *word() noexcept { return reinterpret_cast<int *>(&state_); }
+    std::atomic<int> state_{0};
+};
+
+#endif // defined(__linux__)
+
+/// @brief  Sequence lock for read-mostly data. Writers make the sequence odd for the duration of the update,
+///         and readers never write anything: they retry, if the sequence was odd or changed under them.
+///         The protected data must be read with relaxed atomics, as the readers race with the writers.
+class seqlock_t {
+  public:
+    template <typename reader_at> void read(reader_at &&reader) const noexcept {
+        for (std::size_t attempts = 0;; spin_pause(attempts)) {
+            std::uint64_t const before = sequence_.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+            reader();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before)
+                return;
+        }
+    }
+    template <typename writer_at> void write(writer_at &&writer) noexcept {
+        std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        for (std::size_t attempts = 0;
+             (sequence & 1) || !sequence_.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire,
+                                                                std::memory_order_relaxed);) {
+            spin_pause(attempts);
+            sequence = sequence_.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        writer();
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+  private:
+    std::atomic<std::uint64_t> sequence_{0};
+};
+
+/// @brief  Runs on every benchmark thread, pinned to its own core. Each iteration increments `length` shared
+///         words under the lock, and the first thread checks afterwards, that no increment was lost.
+template <typename mutex_at> static void lock_contention(bm::State &state) {
+    auto length = static_cast<std::size_t>(state.range(0));
+    static mutex_at mutex;
+    static std::vector<std::uint64_t> payload;
+    auto const thread_index = static_cast<std::size_t>(state.thread_index());
+    if (thread_index == 0)
+        payload.assign(length, 0);
+
+    std::vector<logical_cpu_t> const cpus = contention_cpus(false), all_cpus = available_cpus();
+    pin_current_thread(cpus[thread_index % cpus.size()]);
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        std::lock_guard<mutex_at> guard(mutex);
+        for (std::uint64_t &word : payload)
+            ++word;
+        bm::ClobberMemory();
+    }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pin_current_thread(all_cpus);
+
+    double const acquisitions = static_cast<double>(state.iterations());
+    if (thread_index == 0 && payload.front() != static_cast<std::uint64_t>(state.iterations() * state.threads()))
+        return state.SkipWithError("The lock let two threads in at once");
+    state.counters["ns_per_acquisition"] = bm::Counter(seconds * 1e9 / acquisitions, bm::Counter::kAvgThreads);
+    state.counters["acquisitions_per_second"] = acquisitions / seconds;
+}
+
+static void lock_contention_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"length"})->ArgsProduct({{1, 16, 256}});
+    for (std::int64_t threads : thread_counts())
+        benchmark->Threads(static_cast<int>(threads));
+    benchmark->UseRealTime();
+}
+
+// With a single thread, every lock is just an uncontended atomic, and they all take 10-35 ns. Under contention
+// the spinlocks hand the line back and forth between polling cores, and the TTAS lock often lets the same core
+// re-acquire it, which is great for throughput and terrible for fairness. Ticket and MCS locks are fair, so
+// every hand-off is a cache miss, but the MCS lock keeps it to a single line, and scales the best.
+// The `std::mutex`, the futex mutex and the exclusive side of `std::shared_mutex` spin only briefly, if at all,
+// and then sleep, so they pay microseconds for every wake-up, but don't waste the cores of the waiters.
+// With longer critical sections, the time under the lock dominates, and the differences fade.
+BENCHMARK_TEMPLATE(lock_contention, std::mutex)->Apply(lock_contention_arguments);
+BENCHMARK_TEMPLATE(lock_contention, ttas_spinlock_t)->Apply(lock_contention_arguments);
+BENCHMARK_TEMPLATE(lock_contention, ticket_lock_t)->Apply(lock_contention_arguments);
+BENCHMARK_TEMPLATE(lock_contention, mcs_lock_t)->Apply(lock_contention_arguments);
+#if defined(__linux__)
+BENCHMARK_TEMPLATE(lock_contention, futex_mutex_t)->Apply(lock_contention_arguments);
+#endif
+BENCHMARK_TEMPLATE(lock_contention, std::shared_mutex)->Apply(lock_contention_arguments);
+
+/// Runs the `reader` under the lock, sharing it with other readers, where the lock allows it.
+template <typename lock_at, typename reader_at> void read_under(lock_at &lock, reader_at &&reader) {
+    if constexpr (std::is_same_v<lock_at, seqlock_t>) {
+        lock.read(reader);
+    } else if constexpr (std::is_same_v<lock_at, std::shared_mutex>) {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        reader();
+    } else {
+        std::lock_guard<lock_at> guard(lock);
+        reader();
+    }
+}
+
+/// Runs the `writer` under the lock, excluding everyone else.
+template <typename lock_at, typename writer_at> void write_under(lock_at &lock, writer_at &&writer) {
+    if constexpr (std::is_same_v<lock_at, seqlock_t>) {
+        lock.write(writer);
+    } else {
+        std::lock_guard<lock_at> guard(lock);
+        writer();
+    }
+}
+
+/// @brief  Read-mostly workload: `write_percent` of the operations increment all `length` words of the shared
+///         record, and the rest read it. Every reader checks, that it saw all words equal, and never a torn update.
+template <typename lock_at> static void reader_writer(bm::State &state) {
+    auto write_percent = static_cast<std::size_t>(state.range(0));
+    auto length = static_cast<std::size_t>(state.range(1));
+    static lock_at lock;
+    static std::unique_ptr<std::atomic<std::uint64_t>[]> record;
+    auto const thread_index = static_cast<std::size_t>(state.thread_index());
+    if (thread_index == 0)
+        record = std::make_unique<std::atomic<std::uint64_t>[]>(length);
+
+    std::vector<logical_cpu_t> const cpus = contention_cpus(false), all_cpus = available_cpus();
+    pin_current_thread(cpus[thread_index % cpus.size()]);
+    std::size_t operation = thread_index, torn = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        if (++operation % 100 < write_percent)
+            write_under(lock, [&] {
+                for (std::size_t i = 0; i != length; ++i)
+                    record[i].store(record[i].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            });
+        else {
+            bool consistent = true;
+            read_under(lock, [&] {
+                std::uint64_t const first = record[0].load(std::memory_order_relaxed);
+                consistent = true;
+                for (std::size_t i = 1; i != length; ++i)
+                    consistent &= record[i].load(std::memory_order_relaxed) == first;
+            });
+            torn += !consistent;
+        }
+    }
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pin_current_thread(all_cpus);
+
+    if (torn)
+        return state.SkipWithError("A reader saw a partial update");
+    state.counters["ns_per_operation"] = bm::Counter(seconds * 1e9 / state.iterations(), bm::Counter::kAvgThreads);
+    state.counters["operations_per_second"] = state.iterations() / seconds;
+}
+
+static void reader_writer_arguments(bm::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"write_percent", "length"})->ArgsProduct({{0, 1, 10, 50}, {2, 32}});
+    for (std::int64_t threads : thread_counts())
+        benchmark->Threads(static_cast<int>(threads));
+    benchmark->UseRealTime();
+}
+
+// Readers of a `std::shared_mutex` don't wait for each other, but every one of them still increments and
+// decrements the shared reader count, so the lock line bounces just as with the plain `std::mutex`.
+// The readers of a seqlock only load the sequence, so they keep a shared copy of its line and scale linearly,
+// as long as writes are rare. With frequent writes, they retry more and more, and the advantage melts away.
+BENCHMARK_TEMPLATE(reader_writer, std::mutex)->Apply(reader_writer_arguments);
+BENCHMARK_TEMPLATE(reader_writer, std::shared_mutex)->Apply(reader_writer_arguments);
+BENCHMARK_TEMPLATE(reader_writer, seqlock_t)->Apply(reader_writer_arguments);
+
+/// @brief  Centralized sense-reversing barrier. The last thread to arrive re-arms the counter and flips the
+///         shared sense, while the others spin until the sense matches the one they expect for this phase.
+class sense_barrier_t {
+  public:
+    explicit sense_barrier_t(std::ptrdiff_t threads) noexcept : threads_(threads), remaining_(threads) {}
+
+    void arrive_and_wait() noexcept {
+        // The sense can't flip before this thread arrives, so its current value belongs to the previous phase.
+        bool const sense = !sense_.load(std::memory_order_relaxed);
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            remaining_.store(threads_, std::memory_order_relaxed);
+            sense_.store(sense, std::memory_order_release);
+            return;
+        }
+        for (std::size_t attempts = 0; sense_.load(std::memory_order_acquire) != sense;)
+            spin_pause(attempts);
+    }
+
+  private:
+    std::ptrdiff_t threads_ = 0;
+    std::atomic<std::ptrdiff_t> remaining_{0};
+    std::atomic<bool> sense_{false};
+};
+
+/// @brief  Every iteration is one phase, that all benchmark threads must finish before any of them proceeds.
+///         Google Benchmark runs the same number of iterations on every thread, so the phases line up.
+template <typename barrier_at> static void phase_barrier(bm::State &state) {
+    static std::unique_ptr<barrier_at> barrier;
+    auto const thread_index = static_cast<std::size_t>(state.thread_index());
+    if (thread_index == 0)
+        barrier = std::make_unique<barrier_at>(state.threads());
+
+    std::vector<logical_cpu_t> const cpus = contention_cpus(false), all_cpus = available_cpus();
+    pin_current_thread(cpus[thread_index % cpus.size()]);
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state)
+        barrier->arrive_and_wait();
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pin_current_thread(all_cpus);
+
+    state.counters["ns_per_phase"] = bm::Counter(seconds * 1e9 / state.iterations(), bm::Counter::kAvgThreads);
+}
+
+static void phase_barrier_arguments(bm::internal::Benchmark *benchmark) {
+    for (std::int64_t threads : thread_counts())
+        benchmark->Threads(static_cast<int>(threads));
+    benchmark->UseRealTime();
+}
+
+// A phase costs at least one round of line transfers: every thread decrements the counter, and then reloads
+// the flipped sense. The spin barrier stays in that range, while `std::barrier` implementations wait on the
+// atomic with `std::atomic::wait`, which spins briefly before sleeping in the kernel, and may cost microseconds,
+// when the threads arrive unevenly.
+BENCHMARK_TEMPLATE(phase_barrier, sense_barrier_t)->Apply(phase_barrier_arguments);
+#if defined(__cpp_lib_barrier)
+BENCHMARK_TEMPLATE(phase_barrier, std::barrier<>)->Apply(phase_barrier_arguments);
+#endif
+
+// ------------------------------------
+// ## Calling the benchmarks
+// ------------------------------------
+//
+// The default variant is to invoke the `BENCHMARK_MAIN()` macro.
+// Alternatively, we can unpack it, if we want to augment the main function
 // with more system logging logic.
 int main(int argc, char **argv) {
 
     // Let's log the CPU specs:
     memory_specs_t const specs = fetch_memory_specs();
     std::printf("Cache Line Size: %zu bytes\n", specs.cache_line_size);
+    std::printf("L1 Data Cache Size: %zu bytes\n", specs.l1_cache_size);
     std::printf("L2 Cache Size: %zu bytes\n", specs.l2_cache_size);
+    std::printf("L3 Cache Size: %zu bytes\n", specs.l3_cache_size);
 
     // Make sure the defaults are set correctly:
     char arg0_default[] = "benchmark";
@@ -903,6 +8011,7 @@ int main(int argc, char **argv) {
     bm::Initialize(&argc, argv);
     if (bm::ReportUnrecognizedArguments(argc, argv))
         return 1;
+
     bm::RunSpecifiedBenchmarks();
     bm::Shutdown();
     return 0;